@@ -0,0 +1,69 @@
+#import <Foundation/Foundation.h>
+#import <MTool/MTType.h>
+
+@class MTObjectFile;
+
+NS_ASSUME_NONNULL_BEGIN
+
+// A single member of a static library. Member data is a view into the archive; it is never copied.
+@interface MTArchiveMember : NSObject
+
+// The member name, with BSD long names (`#1/<length>`) resolved.
+@property (nonatomic, readonly) NSString *name;
+
+// Offset of the member header in the archive. This is what the symbol table references.
+@property (nonatomic, readonly) UInt64 headerOffset;
+
+// Offset and size of the member contents (excluding any long name)
+@property (nonatomic, readonly) UInt64 offset;
+
+@property (nonatomic, readonly) UInt64 size;
+
+@property (nonatomic, readonly) UInt64 modificationTime;
+
+// The member contents. This keeps the archive storage alive for as long as it is referenced.
+@property (nonatomic, readonly) NSData *data;
+
+// Is this a symbol table (__.SYMDEF*) rather than a real member?
+@property (nonatomic, readonly) BOOL isSymbolTable;
+
+// The member parsed as an object file. This is parsed on first access (or by - [MTArchive parseMembers])
+// This is nil if the member is not a Mach-O object file.
+@property (nonatomic, readonly, nullable) MTObjectFile *object;
+
+@end
+
+// Note: Only BSD style archives (as made by Apple's ar/libtool) are supported.
+@interface MTArchive : NSObject
+
+// The data is retained, not copied. Member data refers directly into it.
++ (instancetype) loadFromData:(NSData *)data;
+
+// The file is mapped, not read.
++ (instancetype) loadFromURL:(NSURL *)url;
+
+// Every member except the symbol table, in archive order.
+@property (nonatomic, readonly) NSArray<MTArchiveMember *> *members;
+
+// The __.SYMDEF member, if present.
+@property (nonatomic, readonly, nullable) MTArchiveMember *symbolTable;
+
+// Is the symbol table sorted (`__.SYMDEF SORTED`)?
+@property (nonatomic, readonly) BOOL isSymbolTableSorted;
+
+// Number of unique symbols in the symbol table index
+@property (nonatomic, readonly) NSUInteger symbolCount;
+
+// Parse every member as an object file, in parallel. Returns the number of members parsed successfully.
+- (NSUInteger) parseMembers;
+
+// Look up which member defines a symbol in the archive symbol table. This is a hash lookup.
+// If a symbol is defined in multiple members, the first in the symbol table wins (as with ld64).
+- (nullable MTArchiveMember *) memberDefiningSymbol:(NSString *)symbol;
+
+// Same as above, without needing an NSString
+- (nullable MTArchiveMember *) memberDefiningSymbolName:(const char *)symbol;
+
+@end
+
+NS_ASSUME_NONNULL_END
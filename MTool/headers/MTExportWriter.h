@@ -0,0 +1,83 @@
+#import <Foundation/Foundation.h>
+#import <MTool/MTType.h>
+
+@class MTMachO;
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Tables in an export file. Every row in the other tables refers back to a slice by `slice_id`.
+typedef NS_ENUM(UInt32, MTExportTable) {
+    // slice_id u64, path string, arch string, filetype u32, ncmds u32, flags u32, file_offset u64, size u64
+    kMTExportTableSlices        = 0,
+
+    // slice_id u64, index u32, cmd u32, cmdsize u32, offset u64
+    kMTExportTableLoadCommands  = 1,
+
+    // slice_id u64, name string, reference_type u32, current_version u32, compatibility_version u32
+    kMTExportTableDylibs        = 2,
+
+    // slice_id u64, name string, type u32, sect u32, desc u32, value u64
+    kMTExportTableSymbols       = 3,
+
+    kMTExportTableCount         = 4
+};
+
+// Column encodings. Compressed columns fall back to raw if compression doesn't help.
+typedef NS_ENUM(UInt32, MTExportEncoding) {
+    kMTExportEncodingRaw        = 0,
+    kMTExportEncodingLZFSE      = 1
+};
+
+// The export file format is columnar, and written in row groups:
+//
+// "MTEXPv1\0"
+// row group 0..n, in no particular order:
+//   UInt32 table, UInt32 rowCount, UInt32 columnCount
+//   for each column: UInt32 encoding, UInt64 rawSize, UInt64 storedSize, <storedSize bytes>
+// footer:
+//   UInt32 rowGroupCount
+//   for each row group: UInt32 table, UInt32 rowCount, UInt64 offset, UInt64 size
+// UInt64 footerOffset, "MTEXPv1\0"
+//
+// Everything is little endian. u32/u64 columns are packed arrays. String columns are a packed array of
+//   UInt32 lengths followed by the concatenated (non-terminated) bytes. Dylib and symbol names are copied from the
+//   image exactly as they appear, so they are usually, but not necessarily, UTF-8. Everything else is UTF-8.
+// Readers should start from the footer. Row groups from different shards are interleaved arbitrarily.
+
+// A shard buffers rows for one worker. Shards are not thread safe, but any number of shards can be
+//   used concurrently. Each shard flushes its own row groups straight to the output file; the only shared
+//   state is an atomic file offset, so workers never wait on each other.
+// Shards don't keep their writer alive. Once it's released, adding and flushing fail.
+@interface MTExportShard : NSObject
+
+// Add a row for this image to the slices table, along with all of its load commands, dylib references and symbols.
+// Only what the image was loaded with is exported (see MTLoadFilter). Returns NO on write failure.
+- (BOOL) addImage:(MTMachO *)image path:(NSString *)path fileOffset:(UInt64)offset;
+
+// Write out any buffered rows as (partial) row groups.
+- (BOOL) flush;
+
+@end
+
+@interface MTExportWriter : NSObject
+
+// Create (or truncate) the export file at `url`.
+- (nullable instancetype) initWithURL:(NSURL *)url;
+
+// Shards pick these up when they are created, so set them first.
+// A row group is flushed once it has this many rows. Defaults to 65536.
+@property (nonatomic) NSUInteger rowGroupRows;
+
+// ... or once it has buffered this many bytes, whichever comes first. Defaults to 16MB.
+// Memory use is bounded by roughly (shard count * table count * rowGroupBytes)
+@property (nonatomic) NSUInteger rowGroupBytes;
+
+// Create a new shard. Use one per worker thread.
+- (MTExportShard *) newShard;
+
+// Flush every shard and write the footer. No shard may be used after this (or concurrently with it).
+- (BOOL) finish;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -1,6 +1,7 @@
 #import <Foundation/Foundation.h>
 #import <MTool/MTType.h>
 
+@class MTLoadFilter;
 @class MTMachO;
 
 NS_ASSUME_NONNULL_BEGIN
@@ -41,6 +42,12 @@ NS_ASSUME_NONNULL_BEGIN
 
 + (instancetype) loadFromURL:(NSURL *)url;
 
+// As above, but return nil (without logging) if no member is accepted by `filter`.
+// Only the FAT header and entries are read to decide this. Member images are not touched.
++ (nullable instancetype) loadFromData:(NSData *)data filter:(MTLoadFilter *)filter;
+
++ (nullable instancetype) loadFromURL:(NSURL *)url filter:(MTLoadFilter *)filter;
+
 // Create a new archive containing the provided file objects, optionally writing to the provided URL
 + (instancetype) createArchiveForFiles:(NSArray<MTMachO *> *)fileList is64bit:(BOOL)is64bit atURL:(nullable NSURL *)url;
 
@@ -76,6 +83,13 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (NSData *) dataForEntry:(MTFatFileEntryDescriptor *)entry;
 
+// Members whose machine type is accepted by `filter`, in archive order.
+- (NSArray<MTFatFileEntryDescriptor *> *) membersMatchingFilter:(MTLoadFilter *)filter;
+
+// Load the image for an entry, decoding only what `filter` asks for.
+// Unlike - dataForEntry:, this doesn't copy anything; the image refers directly into the (mapped) archive.
+- (nullable MTMachO *) imageForEntry:(MTFatFileEntryDescriptor *)entry filter:(nullable MTLoadFilter *)filter;
+
 - (BOOL) writeArchiveToStream:(NSOutputStream *)stream;
 
 - (BOOL) writeArchiveToURL:(NSURL *)url;
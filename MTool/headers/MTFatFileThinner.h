@@ -0,0 +1,55 @@
+#import <Foundation/Foundation.h>
+#import <MTool/MTType.h>
+
+@class MTLoadFilter;
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, MTThinResult) {
+    // The file was replaced with only the wanted slices.
+    kMTThinResultThinned,
+
+    // The file isn't a FAT file. It was left alone.
+    kMTThinResultNotFat,
+
+    // Every slice in the file is wanted. It was left alone.
+    kMTThinResultNothingToRemove,
+
+    // No slice in the file is wanted. It was left alone rather than emptied.
+    kMTThinResultNoMatch,
+
+    kMTThinResultFailed
+};
+
+// Replaces FAT files on disk with just the slices for some set of architectures.
+// If one slice is kept, the result is a thin image. Otherwise, it's a smaller FAT file in the same format (32 or 64 bit).
+// Output is written next to the original and renamed over it, so a file is never seen half thinned.
+//   Permissions, ACLs and extended attributes are carried over.
+// Note: Since the file is replaced, other hard links to it keep the original contents.
+@interface MTFatFileThinner : NSObject
+
+// Keep slices accepted by any of these filters. Only their machine type and subtype matter.
+- (instancetype) initWithTargets:(NSArray<MTLoadFilter *> *)targets;
+
+// Targets by name (ex. "arm64e"). Returns nil if any name isn't recognized.
++ (nullable instancetype) thinnerForArchNames:(NSArray<NSString *> *)names;
+
+// Keep only the slice this machine would pick to run: one of its exact subtype if there is one, otherwise the
+//   generic subtype of its CPU type (ex. arm64 on an arm64e machine). Files with neither are left alone.
++ (nullable instancetype) thinnerForCurrentMachine;
+
+@property (nonatomic, readonly) NSArray<MTLoadFilter *> *targets;
+
+// If set, nothing is written, but results and savings are reported as if it were.
+@property (nonatomic) BOOL dryRun;
+
+// Thin one file. `saved` (if provided) gets the number of bytes the file shrank by.
+- (MTThinResult) thinFileAtURL:(NSURL *)url bytesSaved:(UInt64 *_Nullable)saved;
+
+// Thin many files concurrently. This is almost entirely I/O, so several workers per core are started.
+// `handler` is called from worker threads as each file finishes. Returns the total number of bytes saved.
+- (UInt64) thinFilesAtURLs:(NSArray<NSURL *> *)urls handler:(nullable void (^)(NSURL *url, MTThinResult result, UInt64 saved))handler;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,57 @@
+#import <Foundation/Foundation.h>
+#import <MTool/MTType.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// A load filter describes which parts of an image a caller actually needs.
+// Passing one to the MTMachO or MTFatFile loaders lets them reject non-matching files straight from the
+//   (fat or mach) header, and skip decoding any load command or section the filter doesn't ask for.
+// Images loaded with a filter only contain objects for the requested commands in `allLoadCommands`.
+// Filters are not modified by loaders, so one filter may be shared between loads on any number of threads,
+//   as long as it isn't modified while in use.
+@interface MTLoadFilter : NSObject
+
+// A new filter accepts images of any architecture, and requests no load commands at all.
+- (instancetype) init;
+
+// A filter requesting every load command. This is what loading without a filter does.
++ (instancetype) filterForAllLoadCommands;
+
+// Only accept images of this type. This defaults to kMTMachineTypeAny.
+@property (nonatomic) MTMachineType machineType;
+
+// Only accept images of this subtype (capability bits are ignored). This defaults to CPU_SUBTYPE_MULTIPLE, which accepts any subtype.
+// This is ignored if `machineType` is kMTMachineTypeAny.
+@property (nonatomic) MTMachineSubtype subtype;
+
+// Are all load commands requested?
+@property (nonatomic, readonly) BOOL wantsAllLoadCommands;
+
+// Load command types (LC_*) explicitly requested
+@property (nonatomic, readonly) NSSet<NSNumber *> *loadCommands;
+
+- (void) addLoadCommand:(UInt32)command;
+
+- (void) addAllLoadCommands;
+
+// Request a single section. This implies the segment command it is in, but only that section is decoded from it.
+- (void) addSectionNamed:(NSString *)section inSegment:(NSString *)segment;
+
+// Add everything requested by another filter to this one. Machine type is not affected.
+- (void) addRequirementsFromFilter:(MTLoadFilter *)filter;
+
+// These are what loaders use. They are cheap enough to call for every command in every image.
+
+- (BOOL) acceptsMachineType:(MTMachineType)type subtype:(MTMachineSubtype)subtype;
+
+- (BOOL) wantsLoadCommand:(UInt32)command;
+
+// Does this filter want any section in the segment with this name? `name` need not be NUL terminated (as in segment_command)
+- (BOOL) wantsSegmentNamed:(const char *)name;
+
+// Should this section be decoded? Names need not be NUL terminated (as in struct section)
+- (BOOL) wantsSectionNamed:(const char *)section inSegment:(const char *)segment;
+
+@end
+
+NS_ASSUME_NONNULL_END
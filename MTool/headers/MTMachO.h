@@ -3,7 +3,7 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
-@class MTMappedRegion;
+@class MTLoadFilter;
 @class MTMachO;
 
 typedef NS_ENUM(NSUInteger, MTDylibReferenceType) {
@@ -27,9 +27,52 @@ typedef NS_ENUM(NSUInteger, MTDylibReferenceType) {
 
 @end
 
+@interface MTSectionInfo : NSObject
+
+@property (nonatomic, readonly) NSString *segmentName;
+
+@property (nonatomic, readonly) NSString *name;
+
+@property (nonatomic, readonly) UInt64 address;
+
+@property (nonatomic, readonly) UInt64 size;
+
+@property (nonatomic, readonly) UInt32 fileOffset;
+
+// This property holds the shift size for the alignment. The true alignment is 1 << `alignment`
+@property (nonatomic, readonly) UInt32 alignment;
+
+@property (nonatomic, readonly) UInt32 relocationOffset;
+
+@property (nonatomic, readonly) UInt32 relocationCount;
+
+@property (nonatomic, readonly) UInt32 flags;
+
+// This is `flags & SECTION_TYPE` (ex. S_ZEROFILL)
+@property (nonatomic, readonly) UInt32 sectionType;
+
+@end
+
+// Note: Both 32 and 64 bit segments are represented by this class. All fields are widened to 64 bits.
 @interface MTSegmentInfo : MTLoadCommand
 
-@property (nonatomic, readonly) MTMappedRegion *data;
+@property (nonatomic, readonly) NSString *name;
+
+@property (nonatomic, readonly) UInt64 vmAddress;
+
+@property (nonatomic, readonly) UInt64 vmSize;
+
+@property (nonatomic, readonly) UInt64 fileOffset;
+
+@property (nonatomic, readonly) UInt64 fileSize;
+
+@property (nonatomic, readonly) vm_prot_t maxProtection;
+
+@property (nonatomic, readonly) vm_prot_t initialProtection;
+
+@property (nonatomic, readonly) UInt32 flags;
+
+@property (nonatomic, readonly) NSArray<MTSectionInfo *> *sections;
 
 @end
 
@@ -39,9 +82,21 @@ typedef NS_ENUM(NSUInteger, MTDylibReferenceType) {
 
 @property (nonatomic, readonly) MTDylibReferenceType referenceType;
 
-// Note: This is lazily loaded. Only supported for libraries in some types of objects
-//  (specifically when we need to resolve an @rpath or @executable_path or something.
-@property (nonatomic, readonly) MTMachO *image;
+// Note: Referenced libraries aren't resolved yet, so this is always nil.
+@property (nonatomic, readonly, nullable) MTMachO *image;
+
+@end
+
+// Represents LC_BUILD_VERSION as well as the older LC_VERSION_MIN_* commands.
+// Versions are encoded as in the load commands: xxxx.yy.zz as nibbles 0xXXXXYYZZ
+@interface MTBuildVersionInfo : MTLoadCommand
+
+// PLATFORM_* from mach-o/loader.h. For LC_VERSION_MIN_* commands, this is derived from the command type.
+@property (nonatomic, readonly) UInt32 platform;
+
+@property (nonatomic, readonly) UInt32 minimumVersion;
+
+@property (nonatomic, readonly) UInt32 sdkVersion;
 
 @end
 
@@ -63,6 +118,81 @@ typedef NS_ENUM(NSUInteger, MTDylibReferenceType) {
 
 @end
 
+// Represents LC_LINKER_OPTION. These are only found in object files (ex. from `#pragma comment(lib, ...)` or autolinking).
+@interface MTLinkerOptionInfo : MTLoadCommand
+
+// The arguments this command passes to the linker, in order (ex. @[@"-framework", @"Foundation"])
+@property (nonatomic, readonly) NSArray<NSString *> *options;
+
+@end
+
+#pragma mark - Object File Data
+
+typedef NS_OPTIONS(UInt8, MTRelocationFlags) {
+    kMTRelocationFlagPCRelative     = 1 << 0,
+
+    // `symbolNumbers` holds a symbol table index rather than a section ordinal.
+    kMTRelocationFlagExtern         = 1 << 1,
+
+    // This came from a scattered_relocation_info. `values` holds the target address, and `symbolNumbers` is 0.
+    kMTRelocationFlagScattered      = 1 << 2,
+
+    // The next entry belongs to this one (ex. SECTDIFF followed by PAIR, SUBTRACTOR followed by UNSIGNED, or
+    //   ARM64_RELOC_ADDEND followed by the relocation it applies to)
+    kMTRelocationFlagPairFirst      = 1 << 3,
+
+    // This entry belongs to the previous one.
+    kMTRelocationFlagPairSecond     = 1 << 4
+};
+
+// The relocations for one section, decoded into parallel arrays with one element per relocation_info in the file.
+// Every table from one image shares a single buffer, so decoding an image costs one allocation for the entries.
+// Arrays stay valid for as long as the table does.
+@interface MTRelocationTable : NSObject
+
+// The section these apply to
+@property (nonatomic, readonly) MTSectionInfo *section;
+
+@property (nonatomic, readonly) NSUInteger count;
+
+// r_address: The offset in the section (for scattered relocations, the low 24 bits are all there is)
+@property (nonatomic, readonly) const UInt32 *addresses;
+
+// r_symbolnum: A symbol index if extern, otherwise a 1-based section ordinal (or R_ABS)
+@property (nonatomic, readonly) const UInt32 *symbolNumbers;
+
+// r_value for scattered relocations, 0 otherwise
+@property (nonatomic, readonly) const UInt32 *values;
+
+// r_type. The meaning depends on the architecture (see mach-o/reloc.h and the per-architecture headers)
+@property (nonatomic, readonly) const UInt8 *types;
+
+// r_length: log2 of the size being relocated (0-3)
+@property (nonatomic, readonly) const UInt8 *lengths;
+
+@property (nonatomic, readonly) const MTRelocationFlags *flags;
+
+@end
+
+// The contents of LC_LINKER_OPTIMIZATION_HINT, decoded into parallel arrays.
+// Each hint is a kind (LOH_ARM64_* in ld64) and a list of instruction addresses it applies to.
+@interface MTOptimizationHintTable : NSObject
+
+@property (nonatomic, readonly) NSUInteger count;
+
+@property (nonatomic, readonly) const UInt32 *kinds;
+
+// Hint `i` uses arguments [firstArguments[i], firstArguments[i] + argumentCounts[i])
+@property (nonatomic, readonly) const UInt32 *firstArguments;
+
+@property (nonatomic, readonly) const UInt32 *argumentCounts;
+
+@property (nonatomic, readonly) NSUInteger totalArgumentCount;
+
+@property (nonatomic, readonly) const UInt64 *arguments;
+
+@end
+
 #pragma mark - Mach-O main class
 
 @interface MTMachO : NSObject
@@ -73,11 +203,31 @@ typedef NS_ENUM(NSUInteger, MTDylibReferenceType) {
 // Create an object from a loaded image in an existing process (from memory)
 + (instancetype) loadFromImageInProcess:(NSDictionary<NSString *, id> *)imageInfo;
 
+// Note: The memory provided here must remain valid for the lifetime of the returned object.
 + (instancetype) loadFromMemoryAt:(void *)location maxSize:(NSUInteger)size;
 
-// Create an object from a mach-o file on disk.
+// Create an object from an in-memory image. The data object is retained, not copied.
++ (instancetype) loadFromData:(NSData *)data;
+
+// Create an object from a mach-o file on disk. The file is mapped, not read.
 + (instancetype) loadFromURL:(NSURL *)url;
 
+// These only decode what `filter` asks for (see MTLoadFilter.h). They return nil without logging anything
+//   if the image is rejected by the filter, so they are suitable for scanning large numbers of files.
++ (nullable instancetype) loadFromData:(NSData *)data filter:(nullable MTLoadFilter *)filter;
+
++ (nullable instancetype) loadFromURL:(NSURL *)url filter:(nullable MTLoadFilter *)filter;
+
+// The filter this image was loaded with, if any. If this is set, `allLoadCommands` may be partial.
+@property (nonatomic, readonly, nullable) MTLoadFilter *filter;
+
+// Any combination of 32/64 bit and big/little endian images are supported.
+// The way to decode the image is decided once on load, so there's no extra cost to parse non-native images.
+@property (nonatomic, readonly) BOOL is64bit;
+
+// Is the byte order of this image different from ours?
+@property (nonatomic, readonly) BOOL isSwapped;
+
 @property (nonatomic, readonly) MTMachOImageType type;
 
 @property (nonatomic, readonly) MTMachineType machineType;
@@ -110,9 +260,22 @@ typedef NS_ENUM(NSUInteger, MTDylibReferenceType) {
 
 @end
 
+// Relocatable objects (MH_OBJECT). Load these with `[MTObjectFile loadFromData:]` or similar.
+// Everything here is decoded on request, not at load time, since most users only want part of it.
 @interface MTObjectFile : MTMachO
 
-// TODO: Implement object file parsing.
+// Every section in the image (in the order they appear), skipping any the load filter didn't want.
+@property (nonatomic, readonly) NSArray<MTSectionInfo *> *sections;
+
+// Decode the relocations for every section in `sections`, in the same order. Sections are decoded concurrently
+//   once there are enough relocations to make it worthwhile. Returns nil if any relocations are outside the image.
+- (nullable NSArray<MTRelocationTable *> *) decodeRelocations;
+
+// Every LC_LINKER_OPTION, in order.
+@property (nonatomic, readonly) NSArray<MTLinkerOptionInfo *> *linkerOptions;
+
+// Decode LC_LINKER_OPTIMIZATION_HINT. Returns nil if there isn't one or it's malformed.
+- (nullable MTOptimizationHintTable *) decodeOptimizationHints;
 
 @end
 
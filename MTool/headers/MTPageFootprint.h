@@ -0,0 +1,91 @@
+#import <Foundation/Foundation.h>
+#import <MTool/MTType.h>
+
+@class MTLoadFilter;
+@class MTMachO;
+
+NS_ASSUME_NONNULL_BEGIN
+
+// What a segment is used for, as far as its memory goes. This comes from the segment name, and the
+//   protections for segments without a well known name.
+typedef NS_ENUM(NSUInteger, MTSegmentKind) {
+    // Never written (ex. __TEXT, __PAGEZERO)
+    kMTSegmentKindReadOnly,
+
+    // __DATA, __DATA_DIRTY and anything else writable
+    kMTSegmentKindData,
+
+    // __DATA_CONST: Written by dyld, then made read only
+    kMTSegmentKindDataConst,
+
+    // __AUTH: Signed pointers, written by dyld
+    kMTSegmentKindAuth,
+
+    // __AUTH_CONST
+    kMTSegmentKindAuthConst,
+
+    kMTSegmentKindLinkedit
+};
+
+extern NSString *MTSegmentKindName(MTSegmentKind kind);
+
+// Where an image's load time fixups come from
+typedef NS_ENUM(NSUInteger, MTFixupSource) {
+    kMTFixupSourceNone,
+    kMTFixupSourceChainedFixups,
+    kMTFixupSourceDyldInfo
+};
+
+// The expected memory cost of one segment once its image is loaded. Counts are in pages of the image's
+//   architecture (16K for arm64, 4K otherwise).
+@interface MTSegmentFootprint : NSObject
+
+@property (nonatomic, readonly) NSString *name;
+
+@property (nonatomic, readonly) MTSegmentKind kind;
+
+@property (nonatomic, readonly) UInt64 vmAddress;
+
+@property (nonatomic, readonly) NSUInteger pageCount;
+
+// Pages with at least one rebase or bind. dyld writes these at load, so they're dirty before the image runs.
+@property (nonatomic, readonly) NSUInteger dirtyPageCount;
+
+// Pages past the end of the segment's file data. These cost nothing until first written, but are dirty after.
+@property (nonatomic, readonly) NSUInteger zeroFillPageCount;
+
+@end
+
+// An estimate of the dirty memory an image costs as soon as it's loaded, from its fixups alone.
+// Pages written later by the program itself can't be known without running it, so zero fill pages
+//   are counted separately as an upper bound on what else can become dirty.
+@interface MTImageFootprint : NSObject
+
+// An image needs at least these load commands to be measured. Use this to avoid decoding anything else.
++ (MTLoadFilter *) loadFilter;
+
+// Returns nil if the fixups are malformed.
++ (nullable instancetype) footprintForImage:(MTMachO *)image;
+
+@property (nonatomic, readonly) NSUInteger pageSize;
+
+@property (nonatomic, readonly) MTFixupSource fixupSource;
+
+@property (nonatomic, readonly) NSArray<MTSegmentFootprint *> *segments;
+
+// Sums over every segment
+@property (nonatomic, readonly) NSUInteger dirtyPageCount;
+
+@property (nonatomic, readonly) NSUInteger zeroFillPageCount;
+
+// Page counts times the page size
+@property (nonatomic, readonly) UInt64 dirtyBytes;
+
+@property (nonatomic, readonly) UInt64 zeroFillBytes;
+
+// Dirty pages per kind, indexed by MTSegmentKind
+- (NSUInteger) dirtyPageCountForKind:(MTSegmentKind)kind;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -1,14 +1,104 @@
 #import <Foundation/Foundation.h>
+#import <MTool/MTType.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class MTSharedCache;
+@class MTMachO;
+
+// Note: Image objects do not keep their cache alive. Keep a reference to the cache while using these.
+@interface MTSharedCacheImage : NSObject
+
+// The install name of this image. This is nil if the name isn't valid UTF-8.
+@property (nonatomic, readonly, nullable) NSString *path;
+
+// The unslid address of the image header in the cache
+@property (nonatomic, readonly) UInt64 address;
+
+// Index of this image in the cache image list
+@property (nonatomic, readonly) NSUInteger index;
+
+// Parse the image in place in the cache mapping. Nothing is copied.
+- (nullable MTMachO *) image;
+
+@end
+
+// A rebased view of a single cache mapping which has slide info (the data mappings)
+// The raw contents of these mappings hold encoded pointers (see dyld_cache_slide_info{2,3,5})
+// Pages here are copied and rebased only the first time they are accessed, so touching a few pages
+//   of a large mapping only costs a few pages of memory. All methods are safe to call from any thread.
+// Note: Authenticated pointers are written unsigned, as plain addresses.
+@interface MTSharedCacheRebasedMapping : NSObject
+
+// Unslid address of the start of this mapping
+@property (nonatomic, readonly) UInt64 address;
+
+@property (nonatomic, readonly) UInt64 size;
+
+// The slide applied to every rebased pointer. This is 0 unless requested otherwise.
+@property (nonatomic, readonly) UInt64 slide;
+
+@property (nonatomic, readonly) UInt32 slideInfoVersion;
+
+// The page size used by the slide info. This is the granularity of rebasing.
+@property (nonatomic, readonly) UInt32 pageSize;
+
+@property (nonatomic, readonly) NSUInteger pageCount;
+
+// How many pages have been rebased so far.
+@property (nonatomic, readonly) NSUInteger rebasedPageCount;
+
+// DYLD_CACHE_MAPPING_AUTH_DATA, DYLD_CACHE_MAPPING_CONST_DATA
+@property (nonatomic, readonly) BOOL isAuthData;
+@property (nonatomic, readonly) BOOL isConstData;
+
+// Get the rebased contents of [address, address + size). Any pages not yet rebased are rebased here.
+// This returns NULL if the range is not fully inside this mapping.
+- (nullable const void *) pointerForAddress:(UInt64)address size:(UInt64)size;
+
+// Rebase every page not yet rebased, in parallel. Returns NO if the slide info is malformed.
+- (BOOL) rebaseAllPages;
+
+@end
+
 @interface MTSharedCache : NSObject
 
 + (instancetype) currentSharedCache;
 
 // This will mmap the file at the provided URL
+// Any sub-caches next to this file (ex. '<name>.1', '<name>.2', ...) are mapped as well.
 + (instancetype) loadFromURL:(NSURL *)url;
 
+// The architecture name from the cache magic (ex. 'arm64e')
+@property (nonatomic, readonly) NSString *architecture;
+
+// The main cache file this was loaded from. This is nil for the in-process cache.
+@property (nonatomic, readonly, nullable) NSURL *url;
+
+// The cache UUID from the header. This identifies a cache build, so it's used to validate anything derived from a cache.
+@property (nonatomic, readonly) NSUUID *uuid;
+
+// All the images in this cache, in cache order
+@property (nonatomic, readonly) NSArray<MTSharedCacheImage *> *images;
+
+// Number of mapped files making up this cache (the main cache + any sub-caches)
+@property (nonatomic, readonly) NSUInteger fileCount;
+
+// Translate an unslid address in the cache to a pointer in our address space.
+// This returns NULL unless [address, address + size) is fully inside a single mapping.
+// Note: This gives the raw cache contents. Pointers in data mappings are still encoded with slide info.
+- (nullable const void *) pointerForAddress:(UInt64)address size:(UInt64)size;
+
+// Rebased views of every mapping with (supported) slide info. These are created on first access.
+@property (nonatomic, readonly) NSArray<MTSharedCacheRebasedMapping *> *rebasedMappings;
+
+// Like - pointerForAddress:size:, but pointers in data mappings are decoded (with slide 0)
+// Only the pages in the requested range are rebased. Returns NULL in mappings with slide info we can't handle.
+- (nullable const void *) rebasedPointerForAddress:(UInt64)address size:(UInt64)size;
+
+// Rebase every page in every data mapping, in parallel. Do this before reading most of the cache.
+- (BOOL) rebaseAllMappings;
+
 @end
 
 // This is how dyld loads one of these things... (see SharedCacheRuntime.cpp)
@@ -0,0 +1,26 @@
+#import <Foundation/Foundation.h>
+#import <MTool/MTSharedCache.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// This rebuilds standalone images out of a shared cache, similarly to `dyld_shared_cache_util -extract`
+// Each image gets its segments copied out of the cache, and a new, compacted __LINKEDIT containing only
+//   the parts of the shared __LINKEDIT that image references (symbols, exports, function starts, data in code)
+// Pointers in data segments are written out rebased (see MTSharedCacheRebasedMapping), so fixup information
+//   (rebase/bind opcodes, chained fixups, split seg info) is dropped, along with code signatures.
+// Note: Only 64 bit caches are supported right now. Local symbols from the '.symbols' file are not included.
+@interface MTSharedCache (Extraction)
+
+// Rebuild a single image from this cache into a standalone Mach-O file at the provided URL.
+// Any missing parent directories are created. An existing file at the URL is overwritten.
+- (BOOL) extractImage:(MTSharedCacheImage *)image toURL:(NSURL *)url;
+
+// Extract every provided image into `directory`, using each image's install name as a relative path.
+// Images are extracted concurrently across all available cores. Output is written with positioned writes,
+//   so there is no shared state between workers other than the cache mapping itself.
+// Returns the number of images successfully extracted.
+- (NSUInteger) extractImages:(NSArray<MTSharedCacheImage *> *)images toDirectory:(NSURL *)directory;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,42 @@
+#import <Foundation/Foundation.h>
+#import <MTool/MTSharedCache.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// An index of every symbol exported by every image in a shared cache, keyed by name.
+// Lookups go through a minimal perfect hash (hash and displace), so each one is two hashes and one string compare,
+//   no matter how many images or symbols the cache has.
+// The index is a single flat file meant to be mapped, so loading a saved index costs nothing up front.
+// Note: Re-exports are not included, since they don't have an address of their own. If more than one image
+//   exports the same name, the first image in cache order wins.
+@interface MTSharedCacheSymbolIndex : NSObject
+
+// Walk the export trie of every image in the cache (in parallel) and build a new index.
+// Returns nil if any image's exports can't be read, rather than building an incomplete index.
++ (nullable instancetype) buildForCache:(MTSharedCache *)cache;
+
+// Map a saved index. Returns nil if the file is malformed or was built for a different cache.
++ (nullable instancetype) loadFromURL:(NSURL *)url forCache:(MTSharedCache *)cache;
+
+// Where the index for a cache is saved: next to the cache, as '<cache>.symindex'
++ (nullable NSURL *) defaultURLForCache:(MTSharedCache *)cache;
+
+// Load the saved index for this cache if there is a valid one, otherwise build one and try to save it.
+// Failing to save (ex. the cache is on a read only volume) isn't an error.
++ (nullable instancetype) indexForCache:(MTSharedCache *)cache;
+
+// Save this index. The file is written atomically.
+- (BOOL) writeToURL:(NSURL *)url;
+
+@property (nonatomic, readonly) NSUInteger symbolCount;
+
+// Find the image exporting `symbol`, and the unslid address it's exported at.
+// Returns NO if no image exports the symbol. Either out parameter may be NULL.
+- (BOOL) lookupSymbolName:(const char *)symbol imageIndex:(NSUInteger *_Nullable)imageIndex address:(UInt64 *_Nullable)address;
+
+// As above, but returns the image. Returns nil if the symbol isn't exported anywhere.
+- (nullable MTSharedCacheImage *) imageExportingSymbol:(NSString *)symbol address:(UInt64 *_Nullable)address;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,66 @@
+#import <Foundation/Foundation.h>
+#import <MTool/MTType.h>
+
+@class MTMachO;
+
+NS_ASSUME_NONNULL_BEGIN
+
+// A slice seen by MTStreamReader. A thin image is a single slice covering the whole stream.
+@interface MTStreamSlice : NSObject
+
+// Index in the FAT entry table (0 for thin images)
+@property (nonatomic, readonly) NSUInteger index;
+
+@property (nonatomic, readonly) MTMachineType type;
+
+@property (nonatomic, readonly) MTMachineSubtype subtype;
+
+// Offset and size in the stream. For thin images, size is only known once the stream ends.
+@property (nonatomic, readonly) UInt64 offset;
+
+@property (nonatomic, readonly) UInt64 size;
+
+// This is the shift, not the true alignment. It is 0 for thin images.
+@property (nonatomic, readonly) UInt32 alignment;
+
+// The slice header and load commands, parsed as an image. Nothing past the load commands is available.
+// This is nil if the slice isn't a Mach-O image (ex. a static library in a FAT file).
+@property (nonatomic, readonly, nullable) MTMachO *image;
+
+@end
+
+// This reads a FAT or thin image from a stream in a single forward pass, never seeking.
+// It works on pipes and sockets just as well as files, so nothing needs to be staged to disk first.
+// As bytes pass, each slice gets its headers parsed and is optionally copied to its own output.
+// The only data buffered is what can't be handled in stream order: the FAT header and entry table (which
+//   are replayed to any slice that claims to overlap them) and each slice's header and load commands.
+// Overlapping slices are fine, since every slice sees the same bytes as they go by.
+@interface MTStreamReader : NSObject
+
+// The stream is opened by the reader if it isn't open already.
+- (instancetype) initWithInputStream:(NSInputStream *)stream;
+
++ (instancetype) readerForStandardInput;
+
+// Called as soon as a slice's headers have been parsed. Slices that aren't Mach-O images are reported as soon as
+//   their magic has been read, and slices that end before their headers do are reported when they end.
+@property (nonatomic, copy, nullable) void (^sliceHandler)(MTStreamSlice *slice);
+
+// Called when the first byte of a slice arrives (or the stream reaches an empty slice).
+// Return a stream to copy the slice to, or nil to skip it.
+// The reader opens and closes any stream returned here.
+@property (nonatomic, copy, nullable) NSOutputStream *_Nullable (^outputForSlice)(MTStreamSlice *slice);
+
+// Was the input a FAT file? Only meaningful once - read has been called.
+@property (nonatomic, readonly) BOOL isFat;
+
+// Every slice, in FAT entry order
+@property (nonatomic, readonly) NSArray<MTStreamSlice *> *slices;
+
+// Read the entire stream. Returns NO on read/write errors, malformed headers or a truncated stream.
+// A thin stream is truncated if it ends before its load commands do.
+- (BOOL) read;
+
+@end
+
+NS_ASSUME_NONNULL_END
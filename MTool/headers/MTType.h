@@ -4,10 +4,17 @@
 #import <mach-o/loader.h>
 #import <arpa/inet.h>
 
+// For OSSwapHostToBigInt64, OSSwapBigToHostInt64
+#import <libkern/OSByteOrder.h>
+
 // These are useful for processing FAT files, which store fields in big endian
 #define MTSwapToBigEndian   htonl
 #define MTSwapToHostEndian  ntohl
 
+// htonl/ntohl only handle 32 bit values. 64 bit FAT entries need these for offset and size.
+#define MTSwapToBigEndian64     OSSwapHostToBigInt64
+#define MTSwapToHostEndian64    OSSwapBigToHostInt64
+
 // These are taken from mach-o/loader.h
 // We re-export them with some new names + functions
 enum {
@@ -85,6 +92,9 @@ extern bool MTMachinePairGetCurrent(MTMachineType *type, MTMachineSubtype *subty
 // Methods for getting various information as strings
 extern NSString *MTMachinePairToArchName(MTMachineType type, MTMachineSubtype subtype);
 
+// The inverse of the above (ex. "arm64e" --> CPU_TYPE_ARM64, CPU_SUBTYPE_ARM64E). Return false if the name isn't recognized.
+extern bool MTMachinePairFromArchName(NSString *name, MTMachineType *type, MTMachineSubtype *subtype);
+
 // Machine subtype is a function of machine type, so this function needs both.
 extern NSString *MTMachinePairSubtypeName(MTMachineType type, MTMachineSubtype subtype);
 extern NSString *MTMachineTypeToString(MTMachineType type);
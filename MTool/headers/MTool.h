@@ -3,9 +3,17 @@
 #import <MTool/MTType.h>
 #import <MTool/MTMappedRegion.h>
 #import <MTool/MTSharedCache.h>
+#import <MTool/MTSharedCacheExtractor.h>
+#import <MTool/MTSharedCacheSymbolIndex.h>
 #import <MTool/MTFatFile.h>
+#import <MTool/MTFatFileThinner.h>
+#import <MTool/MTStreamReader.h>
 #import <MTool/MTProcess.h>
+#import <MTool/MTLoadFilter.h>
 #import <MTool/MTMachO.h>
+#import <MTool/MTArchive.h>
+#import <MTool/MTPageFootprint.h>
+#import <MTool/MTExportWriter.h>
 
 FOUNDATION_EXPORT const unsigned char MToolVersionString[];
 FOUNDATION_EXPORT double MToolVersionNumber;
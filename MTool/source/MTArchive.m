@@ -0,0 +1,526 @@
+#import <MTool/MTool.h>
+#import <MTool/MTArchive.h>
+#import <MTool/MTMachO.h>
+
+// For struct ar_hdr, ARMAG, ARFMAG, AR_EFMT1
+#import <ar.h>
+
+// For struct ranlib, struct ranlib_64, SYMDEF*
+#import <mach-o/ranlib.h>
+
+// For counting parsed members across workers
+#import <stdatomic.h>
+
+#pragma mark - Support routines
+
+// Header fields are ASCII decimal, padded with spaces, and not NUL terminated.
+static UInt64 MTArchiveParseDecimal(const char *field, size_t length, BOOL *valid)
+{
+    UInt64 value = 0;
+    size_t i = 0;
+
+    while (i < length && field[i] == ' ')
+        i++;
+
+    if (i == length || field[i] < '0' || field[i] > '9')
+    {
+        (*valid) = NO;
+
+        return 0;
+    }
+
+    for (; i < length && field[i] >= '0' && field[i] <= '9'; i++)
+        value = (value * 10) + (field[i] - '0');
+
+    return value;
+}
+
+// FNV-1a. Symbol names are short, so this is plenty.
+static UInt32 MTArchiveHashName(const char *name)
+{
+    UInt32 hash = 2166136261u;
+
+    for (; *name; name++)
+        hash = (hash ^ (UInt8)(*name)) * 16777619u;
+
+    return hash;
+}
+
+#pragma mark - MTArchiveMember
+
+@interface MTArchiveMember (Private)
+
+- (instancetype) initWithArchiveData:(NSData *)archiveData name:(NSString *)name headerOffset:(UInt64)headerOffset offset:(UInt64)offset size:(UInt64)size modificationTime:(UInt64)time;
+
+// Parse and cache the object file for this member. Returns NO if this isn't an object file.
+- (BOOL) parseObject;
+
+@end
+
+@implementation MTArchiveMember
+{
+    NSData *_archiveData;
+
+    MTObjectFile *_object;
+    BOOL _parsed;
+}
+
+@synthesize name = _name;
+
+@synthesize headerOffset = _headerOffset;
+@synthesize offset = _offset;
+@synthesize size = _size;
+
+@synthesize modificationTime = _modificationTime;
+
+@dynamic isSymbolTable;
+@dynamic object;
+@dynamic data;
+
+- (instancetype) initWithArchiveData:(NSData *)archiveData name:(NSString *)name headerOffset:(UInt64)headerOffset offset:(UInt64)offset size:(UInt64)size modificationTime:(UInt64)time
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->_archiveData = archiveData;
+        self->_name = name;
+
+        self->_headerOffset = headerOffset;
+        self->_offset = offset;
+        self->_size = size;
+
+        self->_modificationTime = time;
+    }
+
+    return self;
+}
+
+- (NSData *) data
+{
+    NSData *archiveData = self->_archiveData;
+    void *bytes = (void *)((const UInt8 *)[archiveData bytes] + self->_offset);
+
+    // Don't copy anything. The deallocator just keeps the archive storage alive as long as this view exists.
+    return [[NSData alloc] initWithBytesNoCopy:bytes length:(NSUInteger)self->_size deallocator:^(void *bytes, NSUInteger length) {
+        (void)archiveData;
+    }];
+}
+
+- (BOOL) isSymbolTable
+{
+    return [self->_name hasPrefix:@SYMDEF];
+}
+
+- (BOOL) parseObject
+{
+    @synchronized (self)
+    {
+        if (self->_parsed)
+            return !!self->_object;
+
+        self->_parsed = YES;
+
+        if ([self isSymbolTable])
+            return NO;
+
+        MTObjectFile *object = [MTObjectFile loadFromData:[self data]];
+
+        if (object && [object type] != kMTMachOImageTypeObject)
+        {
+            NSLog(@"Archive member '%@' is a '%@', not an object file!", self->_name, MTMachOImageTypeName([object type]));
+
+            object = nil;
+        }
+
+        self->_object = object;
+        return !!object;
+    }
+}
+
+- (MTObjectFile *) object
+{
+    [self parseObject];
+
+    return self->_object;
+}
+
+- (NSString *) description
+{
+    return [NSString stringWithFormat:@"%@ (offset 0x%llX, size 0x%llX)", self->_name, self->_offset, self->_size];
+}
+
+@end
+
+#pragma mark - MTArchive
+
+@implementation MTArchive
+{
+    NSData *_data;
+
+    NSArray<MTArchiveMember *> *_members;
+    MTArchiveMember *_symbolTable;
+
+    // Symbol index. This is an open addressing hash table of indices into the arrays below.
+    // Names point directly into the mapped symbol table, they are never copied.
+    const char **_symbolNames;
+    UInt32 *_symbolMembers;
+    NSUInteger _symbolCount;
+
+    UInt32 *_buckets;
+    NSUInteger _bucketMask;
+}
+
+@dynamic isSymbolTableSorted;
+@dynamic symbolTable;
+@dynamic symbolCount;
+@dynamic members;
+
+#pragma mark Loading Archives
+
++ (instancetype) loadFromURL:(NSURL *)url
+{
+    NSError *error;
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:&error];
+
+    if (!data)
+    {
+        NSLog(@"Failed to map file at URL '%@'! (%@)", url, error);
+
+        return nil;
+    }
+
+    return [self loadFromData:data];
+}
+
++ (instancetype) loadFromData:(NSData *)data
+{
+    if ([data length] < SARMAG || memcmp([data bytes], ARMAG, SARMAG))
+    {
+        NSLog(@"Archive magic value malformed!");
+
+        return nil;
+    }
+
+    MTArchive *instance = [[MTArchive alloc] init];
+
+    if (instance)
+    {
+        instance->_data = data;
+
+        if (![instance readMembers])
+            return nil;
+
+        if (instance->_symbolTable && ![instance readSymbolTable])
+            return nil;
+    }
+
+    return instance;
+}
+
+- (BOOL) readMembers
+{
+    const UInt8 *base = (const UInt8 *)[self->_data bytes];
+    UInt64 length = [self->_data length];
+    UInt64 offset = SARMAG;
+
+    NSMutableArray<MTArchiveMember *> *members = [[NSMutableArray alloc] init];
+
+    while (offset < length)
+    {
+        if (offset + sizeof(struct ar_hdr) > length)
+        {
+            NSLog(@"Found truncated member header at offset 0x%llX in archive!", offset);
+
+            return NO;
+        }
+
+        const struct ar_hdr *header = (const struct ar_hdr *)(base + offset);
+        BOOL valid = YES;
+
+        if (memcmp(header->ar_fmag, ARFMAG, sizeof(header->ar_fmag)))
+        {
+            NSLog(@"Found malformed member header at offset 0x%llX in archive!", offset);
+
+            return NO;
+        }
+
+        UInt64 size = MTArchiveParseDecimal(header->ar_size, sizeof(header->ar_size), &valid);
+        UInt64 time = MTArchiveParseDecimal(header->ar_date, sizeof(header->ar_date), &valid);
+        UInt64 dataOffset = offset + sizeof(struct ar_hdr);
+
+        if (!valid || dataOffset + size > length)
+        {
+            NSLog(@"Member at offset 0x%llX in archive has invalid size!", offset);
+
+            return NO;
+        }
+
+        NSString *name;
+
+        // BSD long names are stored right after the header, and are counted in the member size.
+        if (!strncmp(header->ar_name, AR_EFMT1, strlen(AR_EFMT1))) {
+            UInt64 nameLength = MTArchiveParseDecimal(header->ar_name + strlen(AR_EFMT1), sizeof(header->ar_name) - strlen(AR_EFMT1), &valid);
+
+            if (!valid || nameLength > size)
+            {
+                NSLog(@"Member at offset 0x%llX in archive has invalid long name!", offset);
+
+                return NO;
+            }
+
+            const char *longName = (const char *)(base + dataOffset);
+            name = [[NSString alloc] initWithBytes:longName length:strnlen(longName, (size_t)nameLength) encoding:NSUTF8StringEncoding];
+
+            dataOffset += nameLength;
+            size -= nameLength;
+        } else {
+            // Short names are padded with spaces. Some tools also terminate them with '/'
+            size_t nameLength = sizeof(header->ar_name);
+
+            while (nameLength && (header->ar_name[nameLength - 1] == ' ' || header->ar_name[nameLength - 1] == '/'))
+                nameLength--;
+
+            name = [[NSString alloc] initWithBytes:header->ar_name length:nameLength encoding:NSUTF8StringEncoding];
+        }
+
+        MTArchiveMember *member = [[MTArchiveMember alloc] initWithArchiveData:self->_data name:(name ? name : @"") headerOffset:offset offset:dataOffset size:size modificationTime:time];
+
+        // Only the first member can be the symbol table.
+        if (![members count] && !self->_symbolTable && [member isSymbolTable]) {
+            self->_symbolTable = member;
+        } else {
+            [members addObject:member];
+        }
+
+        // Members are padded to an even offset.
+        offset = dataOffset + size;
+        offset += (offset & 1);
+    }
+
+    self->_members = [members copy];
+    return YES;
+}
+
+// Find the member with a given header offset. Members are in file order, so binary search.
+- (NSInteger) indexOfMemberAtHeaderOffset:(UInt64)offset
+{
+    NSInteger low = 0;
+    NSInteger high = (NSInteger)[self->_members count] - 1;
+
+    while (low <= high)
+    {
+        NSInteger middle = low + ((high - low) / 2);
+        UInt64 middleOffset = [[self->_members objectAtIndex:middle] headerOffset];
+
+        if (middleOffset == offset) {
+            return middle;
+        } else if (middleOffset < offset) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return -1;
+}
+
+- (BOOL) readSymbolTable
+{
+    const UInt8 *table = (const UInt8 *)[self->_data bytes] + [self->_symbolTable offset];
+    UInt64 tableSize = [self->_symbolTable size];
+
+    // __.SYMDEF_64 uses 64 bit sizes and entries. The layout is otherwise the same.
+    BOOL is64bit = [[self->_symbolTable name] hasPrefix:@SYMDEF_64];
+    UInt64 wordSize = is64bit ? sizeof(UInt64) : sizeof(UInt32);
+    UInt64 entrySize = is64bit ? sizeof(struct ranlib_64) : sizeof(struct ranlib);
+
+    if (tableSize < wordSize)
+    {
+        NSLog(@"Archive symbol table is truncated!");
+
+        return NO;
+    }
+
+    UInt64 entriesSize = is64bit ? *(const UInt64 *)table : *(const UInt32 *)table;
+
+    if (wordSize + entriesSize + wordSize > tableSize)
+    {
+        NSLog(@"Archive symbol table is truncated!");
+
+        return NO;
+    }
+
+    const UInt8 *entries = table + wordSize;
+    const UInt8 *stringsSizePointer = entries + entriesSize;
+    UInt64 stringsSize = is64bit ? *(const UInt64 *)stringsSizePointer : *(const UInt32 *)stringsSizePointer;
+    const char *strings = (const char *)(stringsSizePointer + wordSize);
+
+    if (wordSize + entriesSize + wordSize + stringsSize > tableSize)
+    {
+        NSLog(@"Archive symbol table strings are truncated!");
+
+        return NO;
+    }
+
+    NSUInteger count = (NSUInteger)(entriesSize / entrySize);
+
+    // Keep the table at most half full.
+    NSUInteger bucketCount = 16;
+
+    while (bucketCount < count * 2)
+        bucketCount <<= 1;
+
+    self->_symbolNames = calloc(count ? count : 1, sizeof(const char *));
+    self->_symbolMembers = calloc(count ? count : 1, sizeof(UInt32));
+    self->_buckets = calloc(bucketCount, sizeof(UInt32));
+    self->_bucketMask = bucketCount - 1;
+
+    if (!self->_symbolNames || !self->_symbolMembers || !self->_buckets)
+    {
+        NSLog(@"Out of memory!");
+
+        return NO;
+    }
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        UInt64 nameOffset;
+        UInt64 memberOffset;
+
+        if (is64bit) {
+            const struct ranlib_64 *entry = (const struct ranlib_64 *)(entries + (i * entrySize));
+
+            nameOffset = entry->ran_un.ran_strx;
+            memberOffset = entry->ran_off;
+        } else {
+            const struct ranlib *entry = (const struct ranlib *)(entries + (i * entrySize));
+
+            nameOffset = entry->ran_un.ran_strx;
+            memberOffset = entry->ran_off;
+        }
+
+        if (nameOffset >= stringsSize || strnlen(strings + nameOffset, (size_t)(stringsSize - nameOffset)) == stringsSize - nameOffset)
+        {
+            NSLog(@"Archive symbol %lu has name outside of string table!", (unsigned long)i);
+
+            continue;
+        }
+
+        NSInteger memberIndex = [self indexOfMemberAtHeaderOffset:memberOffset];
+
+        if (memberIndex < 0)
+        {
+            NSLog(@"Archive symbol '%s' refers to unknown member at offset 0x%llX!", strings + nameOffset, memberOffset);
+
+            continue;
+        }
+
+        const char *name = strings + nameOffset;
+        NSUInteger bucket = MTArchiveHashName(name) & self->_bucketMask;
+        BOOL duplicate = NO;
+
+        // Buckets hold (symbol index + 1), so 0 means empty.
+        while (self->_buckets[bucket])
+        {
+            if (!strcmp(self->_symbolNames[self->_buckets[bucket] - 1], name))
+            {
+                duplicate = YES;
+
+                break;
+            }
+
+            bucket = (bucket + 1) & self->_bucketMask;
+        }
+
+        if (duplicate)
+            continue;
+
+        self->_symbolNames[self->_symbolCount] = name;
+        self->_symbolMembers[self->_symbolCount] = (UInt32)memberIndex;
+        self->_buckets[bucket] = (UInt32)(++self->_symbolCount);
+    }
+
+    return YES;
+}
+
+#pragma mark Property getters
+
+- (NSArray<MTArchiveMember *> *) members
+{
+    return self->_members;
+}
+
+- (MTArchiveMember *) symbolTable
+{
+    return self->_symbolTable;
+}
+
+- (BOOL) isSymbolTableSorted
+{
+    return [[self->_symbolTable name] hasSuffix:@"SORTED"];
+}
+
+- (NSUInteger) symbolCount
+{
+    return self->_symbolCount;
+}
+
+#pragma mark Members and symbols
+
+- (NSUInteger) parseMembers
+{
+    NSArray<MTArchiveMember *> *members = self->_members;
+    atomic_ulong parsedCount = 0;
+    atomic_ulong *parsed = &parsedCount;
+
+    // Members are independent, so this is trivially parallel.
+    dispatch_apply([members count], dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t i) {
+        @autoreleasepool
+        {
+            if ([[members objectAtIndex:i] parseObject])
+                atomic_fetch_add(parsed, 1);
+        }
+    });
+
+    return (NSUInteger)atomic_load(&parsedCount);
+}
+
+- (MTArchiveMember *) memberDefiningSymbolName:(const char *)symbol
+{
+    if (!self->_buckets)
+        return nil;
+
+    NSUInteger bucket = MTArchiveHashName(symbol) & self->_bucketMask;
+
+    while (self->_buckets[bucket])
+    {
+        UInt32 index = self->_buckets[bucket] - 1;
+
+        if (!strcmp(self->_symbolNames[index], symbol))
+            return [self->_members objectAtIndex:self->_symbolMembers[index]];
+
+        bucket = (bucket + 1) & self->_bucketMask;
+    }
+
+    return nil;
+}
+
+- (MTArchiveMember *) memberDefiningSymbol:(NSString *)symbol
+{
+    return [self memberDefiningSymbolName:[symbol UTF8String]];
+}
+
+- (void) dealloc
+{
+    if (self->_symbolNames)
+        free(self->_symbolNames);
+
+    if (self->_symbolMembers)
+        free(self->_symbolMembers);
+
+    if (self->_buckets)
+        free(self->_buckets);
+}
+
+@end
@@ -0,0 +1,547 @@
+#import <MTool/MTool.h>
+#import <MTool/MTExportWriter.h>
+
+#import <mach-o/loader.h>
+#import <mach-o/nlist.h>
+
+// For open, pwrite, close
+#import <fcntl.h>
+#import <unistd.h>
+
+// For compression_encode_buffer
+#import <compression.h>
+
+// For the shared file offset and slice ids
+#import <stdatomic.h>
+
+#import "MTMachOPrivate.h"
+
+#define kMTExportMagic              "MTEXPv1"
+#define kMTExportMagicSize          8
+
+#define kMTExportMaxColumns         8
+
+#define kMTExportDefaultRows        65536
+#define kMTExportDefaultBytes       (16 * 1024 * 1024)
+
+typedef enum {
+    kMTExportColumnU32,
+    kMTExportColumnU64,
+    kMTExportColumnString
+} MTExportColumnType;
+
+typedef struct {
+    UInt32 columnCount;
+    MTExportColumnType columns[kMTExportMaxColumns];
+} MTExportSchema;
+
+// This must match the table descriptions in MTExportWriter.h
+static const MTExportSchema kMTExportSchemas[kMTExportTableCount] = {
+    [kMTExportTableSlices] = { 8, {
+        kMTExportColumnU64, kMTExportColumnString, kMTExportColumnString, kMTExportColumnU32,
+        kMTExportColumnU32, kMTExportColumnU32, kMTExportColumnU64, kMTExportColumnU64
+    } },
+    [kMTExportTableLoadCommands] = { 5, {
+        kMTExportColumnU64, kMTExportColumnU32, kMTExportColumnU32, kMTExportColumnU32, kMTExportColumnU64
+    } },
+    [kMTExportTableDylibs] = { 5, {
+        kMTExportColumnU64, kMTExportColumnString, kMTExportColumnU32, kMTExportColumnU32, kMTExportColumnU32
+    } },
+    [kMTExportTableSymbols] = { 6, {
+        kMTExportColumnU64, kMTExportColumnString, kMTExportColumnU32, kMTExportColumnU32, kMTExportColumnU32, kMTExportColumnU64
+    } }
+};
+
+// One of these per row group written. These are collected from every shard into the footer.
+typedef struct {
+    UInt32 table;
+    UInt32 rowCount;
+    UInt64 offset;
+    UInt64 size;
+} MTExportRowGroupInfo;
+
+// Rows buffered for one table in one shard. For string columns, `values` holds lengths and `strings` the bytes.
+typedef struct {
+    __unsafe_unretained NSMutableData *values[kMTExportMaxColumns];
+    __unsafe_unretained NSMutableData *strings[kMTExportMaxColumns];
+
+    UInt32 rowCount;
+    NSUInteger byteCount;
+} MTExportTableBuffer;
+
+static BOOL MTExportPositionedWrite(int fd, const void *buffer, size_t size, off_t offset)
+{
+    const UInt8 *bytes = buffer;
+
+    while (size)
+    {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return NO;
+        }
+
+        bytes += written;
+        offset += written;
+        size -= written;
+    }
+
+    return YES;
+}
+
+#pragma mark - MTExportWriter (Private)
+
+@interface MTExportWriter (Private)
+
+@property (nonatomic, readonly) int fd;
+
+// Reserve space for `size` bytes at the end of the file. This is the only state shards share.
+- (UInt64) reserve:(UInt64)size;
+
+- (UInt64) nextSliceID;
+
+@end
+
+#pragma mark - MTExportShard
+
+@interface MTExportShard (Private)
+
+- (instancetype) initWithWriter:(MTExportWriter *)writer;
+
+// Descriptors for every row group this shard has written
+@property (nonatomic, readonly) NSData *rowGroups;
+
+@end
+
+@implementation MTExportShard
+{
+    // Shards are owned by their writer, but may outlive it if the caller holds on to them.
+    __weak MTExportWriter *_writer;
+
+    MTExportTableBuffer _tables[kMTExportTableCount];
+
+    // Strong references for the buffers above, which can't hold them themselves.
+    NSMutableArray<NSMutableData *> *_storage;
+
+    NSMutableData *_rowGroups;
+    NSUInteger _rowLimit;
+    NSUInteger _byteLimit;
+}
+
+@dynamic rowGroups;
+
+- (instancetype) initWithWriter:(MTExportWriter *)writer
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->_writer = writer;
+        self->_storage = [[NSMutableArray alloc] init];
+        self->_rowGroups = [[NSMutableData alloc] init];
+
+        self->_rowLimit = [writer rowGroupRows];
+        self->_byteLimit = [writer rowGroupBytes];
+
+        for (UInt32 table = 0; table < kMTExportTableCount; table++)
+        {
+            for (UInt32 column = 0; column < kMTExportSchemas[table].columnCount; column++)
+            {
+                NSMutableData *values = [[NSMutableData alloc] init];
+                NSMutableData *strings = [[NSMutableData alloc] init];
+
+                [self->_storage addObject:values];
+                [self->_storage addObject:strings];
+
+                self->_tables[table].values[column] = values;
+                self->_tables[table].strings[column] = strings;
+            }
+        }
+    }
+
+    return self;
+}
+
+- (NSData *) rowGroups
+{
+    return self->_rowGroups;
+}
+
+#pragma mark Appending rows
+
+- (void) table:(MTExportTable)table column:(UInt32)column u32:(UInt32)value
+{
+    [self->_tables[table].values[column] appendBytes:&value length:sizeof(UInt32)];
+    self->_tables[table].byteCount += sizeof(UInt32);
+}
+
+- (void) table:(MTExportTable)table column:(UInt32)column u64:(UInt64)value
+{
+    [self->_tables[table].values[column] appendBytes:&value length:sizeof(UInt64)];
+    self->_tables[table].byteCount += sizeof(UInt64);
+}
+
+- (void) table:(MTExportTable)table column:(UInt32)column bytes:(const char *)bytes length:(UInt32)length
+{
+    [self->_tables[table].values[column] appendBytes:&length length:sizeof(UInt32)];
+    [self->_tables[table].strings[column] appendBytes:bytes length:length];
+    self->_tables[table].byteCount += sizeof(UInt32) + length;
+}
+
+// A nil string is written as an empty one.
+- (void) table:(MTExportTable)table column:(UInt32)column string:(NSString *)string
+{
+    const char *bytes = [string UTF8String] ?: "";
+
+    [self table:table column:column bytes:bytes length:(UInt32)strlen(bytes)];
+}
+
+// Every row ends here, which is where we decide whether to flush.
+- (BOOL) endRowInTable:(MTExportTable)table
+{
+    MTExportTableBuffer *buffer = &self->_tables[table];
+    buffer->rowCount++;
+
+    if (buffer->rowCount >= self->_rowLimit || buffer->byteCount >= self->_byteLimit)
+        return [self flushTable:table];
+
+    return YES;
+}
+
+#pragma mark Flushing row groups
+
+- (BOOL) flushTable:(MTExportTable)table
+{
+    MTExportTableBuffer *buffer = &self->_tables[table];
+    const MTExportSchema *schema = &kMTExportSchemas[table];
+
+    if (!buffer->rowCount)
+        return YES;
+
+    MTExportWriter *writer = self->_writer;
+
+    if (!writer)
+    {
+        NSLog(@"Export writer was released before its shard was flushed!");
+
+        return NO;
+    }
+
+    NSMutableData *group = [[NSMutableData alloc] init];
+    UInt32 header[3] = { table, buffer->rowCount, schema->columnCount };
+    [group appendBytes:header length:sizeof(header)];
+
+    for (UInt32 column = 0; column < schema->columnCount; column++)
+    {
+        NSMutableData *raw = buffer->values[column];
+
+        if (schema->columns[column] == kMTExportColumnString)
+            [raw appendData:buffer->strings[column]];
+
+        // Each column is compressed on its own; similar values next to each other is the whole point.
+        UInt32 encoding = kMTExportEncodingLZFSE;
+        UInt64 rawSize = [raw length];
+        UInt8 *compressed = malloc(rawSize ? rawSize : 1);
+        size_t storedSize = 0;
+
+        if (compressed && rawSize)
+            storedSize = compression_encode_buffer(compressed, rawSize, [raw bytes], rawSize, NULL, COMPRESSION_LZFSE);
+
+        // This is 0 if the output wouldn't fit in rawSize bytes, in which case it isn't worth it anyway.
+        if (!storedSize)
+        {
+            encoding = kMTExportEncodingRaw;
+            storedSize = rawSize;
+        }
+
+        [group appendBytes:&encoding length:sizeof(UInt32)];
+        [group appendBytes:&rawSize length:sizeof(UInt64)];
+        [group appendBytes:&storedSize length:sizeof(UInt64)];
+        [group appendBytes:(encoding == kMTExportEncodingRaw) ? [raw bytes] : compressed length:storedSize];
+
+        if (compressed)
+            free(compressed);
+
+        [buffer->values[column] setLength:0];
+        [buffer->strings[column] setLength:0];
+    }
+
+    MTExportRowGroupInfo info = {
+        .table = table,
+        .rowCount = buffer->rowCount,
+        .offset = [writer reserve:[group length]],
+        .size = [group length]
+    };
+
+    buffer->rowCount = 0;
+    buffer->byteCount = 0;
+
+    if (!MTExportPositionedWrite([writer fd], [group bytes], [group length], (off_t)info.offset))
+    {
+        NSLog(@"Failed to write export row group! (%s)", strerror(errno));
+
+        return NO;
+    }
+
+    [self->_rowGroups appendBytes:&info length:sizeof(MTExportRowGroupInfo)];
+    return YES;
+}
+
+- (BOOL) flush
+{
+    for (UInt32 table = 0; table < kMTExportTableCount; table++)
+    {
+        if (![self flushTable:table])
+            return NO;
+    }
+
+    return YES;
+}
+
+#pragma mark Exporting images
+
+- (BOOL) addSymbolsForImage:(MTMachO *)image sliceID:(UInt64)sliceID command:(MTLoadCommand *)command
+{
+    const MTImageDecoder *decoder = [image decoder];
+    const UInt8 *base = (const UInt8 *)[[image imageData] bytes];
+    NSUInteger length = [[image imageData] length];
+    const UInt8 *raw = [command rawCommand];
+
+    if ([command range].length < sizeof(struct symtab_command))
+        return YES;
+
+    UInt32 symbolOffset = decoder->read32(raw + offsetof(struct symtab_command, symoff));
+    UInt32 symbolCount = decoder->read32(raw + offsetof(struct symtab_command, nsyms));
+    UInt32 stringOffset = decoder->read32(raw + offsetof(struct symtab_command, stroff));
+    UInt32 stringSize = decoder->read32(raw + offsetof(struct symtab_command, strsize));
+
+    if ((UInt64)symbolOffset + ((UInt64)symbolCount * decoder->symbolSize) > length || (UInt64)stringOffset + stringSize > length)
+    {
+        NSLog(@"Symbol table extends past end of image!");
+
+        return YES;
+    }
+
+    const char *strings = (const char *)(base + stringOffset);
+
+    for (UInt32 i = 0; i < symbolCount; i++)
+    {
+        const UInt8 *symbol = base + symbolOffset + (i * decoder->symbolSize);
+
+        // n_strx, n_type, n_sect and n_desc are laid out the same in nlist and nlist_64. Only n_value differs in width.
+        UInt32 nameOffset = decoder->read32(symbol + offsetof(struct nlist_64, n_un.n_strx));
+        UInt16 desc = *(const UInt16 *)(symbol + offsetof(struct nlist_64, n_desc));
+
+        if (decoder->isSwapped)
+            desc = OSSwapInt16(desc);
+
+        const char *name = (nameOffset < stringSize) ? strings + nameOffset : "";
+        size_t nameLength = strnlen(name, (nameOffset < stringSize) ? stringSize - nameOffset : 0);
+
+        [self table:kMTExportTableSymbols column:0 u64:sliceID];
+        [self table:kMTExportTableSymbols column:1 bytes:name length:(UInt32)nameLength];
+        [self table:kMTExportTableSymbols column:2 u32:symbol[offsetof(struct nlist_64, n_type)]];
+        [self table:kMTExportTableSymbols column:3 u32:symbol[offsetof(struct nlist_64, n_sect)]];
+        [self table:kMTExportTableSymbols column:4 u32:desc];
+        [self table:kMTExportTableSymbols column:5 u64:decoder->readPointer(symbol + offsetof(struct nlist_64, n_value))];
+
+        if (![self endRowInTable:kMTExportTableSymbols])
+            return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL) addImage:(MTMachO *)image path:(NSString *)path fileOffset:(UInt64)offset
+{
+    const struct mach_header_64 *header = [image header];
+    const MTImageDecoder *decoder = [image decoder];
+    MTExportWriter *writer = self->_writer;
+
+    if (!writer)
+    {
+        NSLog(@"Export writer was released before its shard was done!");
+
+        return NO;
+    }
+
+    UInt64 sliceID = [writer nextSliceID];
+
+    [self table:kMTExportTableSlices column:0 u64:sliceID];
+    [self table:kMTExportTableSlices column:1 string:path];
+    [self table:kMTExportTableSlices column:2 string:MTMachinePairToArchName(header->cputype, header->cpusubtype)];
+    [self table:kMTExportTableSlices column:3 u32:header->filetype];
+    [self table:kMTExportTableSlices column:4 u32:header->ncmds];
+    [self table:kMTExportTableSlices column:5 u32:header->flags];
+    [self table:kMTExportTableSlices column:6 u64:offset];
+    [self table:kMTExportTableSlices column:7 u64:[[image imageData] length]];
+
+    if (![self endRowInTable:kMTExportTableSlices])
+        return NO;
+
+    UInt32 index = 0;
+
+    for (MTLoadCommand *command in [image allLoadCommands])
+    {
+        [self table:kMTExportTableLoadCommands column:0 u64:sliceID];
+        [self table:kMTExportTableLoadCommands column:1 u32:index++];
+        [self table:kMTExportTableLoadCommands column:2 u32:[command type]];
+        [self table:kMTExportTableLoadCommands column:3 u32:(UInt32)[command range].length];
+        [self table:kMTExportTableLoadCommands column:4 u64:[command range].location];
+
+        if (![self endRowInTable:kMTExportTableLoadCommands])
+            return NO;
+
+        if ([command isKindOfClass:[MTDylibInfo class]]) {
+            const UInt8 *raw = [command rawCommand];
+            NSUInteger commandSize = [command range].length;
+
+            // Names are copied straight from the command, so a name that isn't valid UTF-8 still comes through as is.
+            // MTDylibInfo already checked the name offset is inside the command.
+            UInt32 nameOffset = decoder->read32(raw + offsetof(struct dylib_command, dylib.name));
+            const char *name = (const char *)(raw + nameOffset);
+
+            [self table:kMTExportTableDylibs column:0 u64:sliceID];
+            [self table:kMTExportTableDylibs column:1 bytes:name length:(UInt32)strnlen(name, commandSize - nameOffset)];
+            [self table:kMTExportTableDylibs column:2 u32:(UInt32)[(MTDylibInfo *)command referenceType]];
+            [self table:kMTExportTableDylibs column:3 u32:decoder->read32(raw + offsetof(struct dylib_command, dylib.current_version))];
+            [self table:kMTExportTableDylibs column:4 u32:decoder->read32(raw + offsetof(struct dylib_command, dylib.compatibility_version))];
+
+            if (![self endRowInTable:kMTExportTableDylibs])
+                return NO;
+        } else if ([command type] == LC_SYMTAB) {
+            if (![self addSymbolsForImage:image sliceID:sliceID command:command])
+                return NO;
+        }
+    }
+
+    return YES;
+}
+
+@end
+
+#pragma mark - MTExportWriter
+
+@implementation MTExportWriter
+{
+    int _fd;
+
+    // Next free byte in the file. Shards bump this to claim space for their row groups.
+    atomic_ullong _offset;
+    atomic_ullong _nextSliceID;
+
+    NSMutableArray<MTExportShard *> *_shards;
+}
+
+@synthesize rowGroupRows = _rowGroupRows;
+@synthesize rowGroupBytes = _rowGroupBytes;
+
+- (instancetype) initWithURL:(NSURL *)url
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->_fd = open([[url path] fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        if (self->_fd < 0)
+        {
+            NSLog(@"Failed to open export file '%@'! (%s)", url, strerror(errno));
+
+            return nil;
+        }
+
+        if (!MTExportPositionedWrite(self->_fd, kMTExportMagic, kMTExportMagicSize, 0))
+        {
+            NSLog(@"Failed to write export file header! (%s)", strerror(errno));
+
+            return nil;
+        }
+
+        atomic_init(&self->_offset, kMTExportMagicSize);
+        atomic_init(&self->_nextSliceID, 0);
+
+        self->_shards = [[NSMutableArray alloc] init];
+        self->_rowGroupRows = kMTExportDefaultRows;
+        self->_rowGroupBytes = kMTExportDefaultBytes;
+    }
+
+    return self;
+}
+
+- (int) fd
+{
+    return self->_fd;
+}
+
+- (UInt64) reserve:(UInt64)size
+{
+    return atomic_fetch_add(&self->_offset, size);
+}
+
+- (UInt64) nextSliceID
+{
+    return atomic_fetch_add(&self->_nextSliceID, 1);
+}
+
+- (MTExportShard *) newShard
+{
+    MTExportShard *shard = [[MTExportShard alloc] initWithWriter:self];
+
+    // This only happens once per worker, so it's fine to synchronize.
+    @synchronized (self->_shards)
+    {
+        [self->_shards addObject:shard];
+    }
+
+    return shard;
+}
+
+- (BOOL) finish
+{
+    if (self->_fd < 0)
+        return NO;
+
+    NSMutableData *footer = [[NSMutableData alloc] init];
+    UInt32 rowGroupCount = 0;
+
+    // Shards only ever append to their own descriptor lists, so merging them is just concatenation.
+    for (MTExportShard *shard in self->_shards)
+    {
+        if (![shard flush])
+            return NO;
+
+        rowGroupCount += (UInt32)([[shard rowGroups] length] / sizeof(MTExportRowGroupInfo));
+    }
+
+    [footer appendBytes:&rowGroupCount length:sizeof(UInt32)];
+
+    for (MTExportShard *shard in self->_shards)
+        [footer appendData:[shard rowGroups]];
+
+    UInt64 footerOffset = [self reserve:[footer length]];
+    [footer appendBytes:&footerOffset length:sizeof(UInt64)];
+    [footer appendBytes:kMTExportMagic length:kMTExportMagicSize];
+
+    BOOL result = MTExportPositionedWrite(self->_fd, [footer bytes], [footer length], (off_t)footerOffset);
+
+    if (!result)
+        NSLog(@"Failed to write export file footer! (%s)", strerror(errno));
+
+    close(self->_fd);
+    self->_fd = -1;
+
+    return result;
+}
+
+- (void) dealloc
+{
+    if (self->_fd >= 0)
+        close(self->_fd);
+}
+
+@end
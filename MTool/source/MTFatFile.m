@@ -7,6 +7,9 @@
 // For struct fat_header, struct fat_arch, etc.
 #import <mach-o/fat.h>
 
+// For MTFatArchDecodeTable
+#import "MTImageDecoder.h"
+
 #pragma mark - MTFatFileEntryDescriptor
 
 @interface MTFatFileEntryDescriptor (Private)
@@ -14,7 +17,8 @@
 // This is used internally
 - (instancetype) initWithType:(MTMachineType)type subtype:(MTMachineSubtype)subtype offset:(UInt64)offset size:(UInt64)size alignment:(UInt32)alignment;
 
-- (instancetype) initWithRawEntry:(const void *)entry is64bit:(BOOL)is64;
+// The entry should already be decoded to host endian. See MTFatArchDecodeTable.
+- (instancetype) initWithEntry:(const struct fat_arch_64 *)entry;
 
 @end
 
@@ -49,30 +53,14 @@
     return self;
 }
 
-- (instancetype) initWithRawEntry:(const void *)_entry is64bit:(BOOL)is64
+- (instancetype) initWithEntry:(const struct fat_arch_64 *)entry
 {
     self = [super init];
 
     if (self)
     {
-        // Internally, we store everything as a 64 bit entry.
-        if (is64) {
-            struct fat_arch_64 *entry = (struct fat_arch_64 *)_entry;
-
-            self->_underlying.cputype = MTSwapToHostEndian(entry->cputype);
-            self->_underlying.cpusubtype = MTSwapToHostEndian(entry->cpusubtype);
-            self->_underlying.offset = MTSwapToHostEndian(entry->offset);
-            self->_underlying.size = MTSwapToHostEndian(entry->size);
-            self->_underlying.align = MTSwapToHostEndian(entry->align);
-        } else {
-            struct fat_arch *entry = (struct fat_arch *)_entry;
-
-            self->_underlying.cputype = MTSwapToHostEndian(entry->cputype);
-            self->_underlying.cpusubtype = MTSwapToHostEndian(entry->cpusubtype);
-            self->_underlying.offset = MTSwapToHostEndian(entry->offset);
-            self->_underlying.size = MTSwapToHostEndian(entry->size);
-            self->_underlying.align = MTSwapToHostEndian(entry->align);
-        }
+        // Internally, we store everything as a 64 bit, host endian entry.
+        self->_underlying = (*entry);
     }
 
     return self;
@@ -114,6 +102,13 @@
 
 #pragma mark - MTFatFile
 
+static BOOL MTFatFileHasMagic(const void *buffer)
+{
+    UInt32 magic = MTSwapToHostEndian(*(const UInt32 *)buffer);
+
+    return (magic == FAT_MAGIC || magic == FAT_MAGIC_64);
+}
+
 @interface MTFatFile (Private)
 
 // Read header, validate magic, detect entry types.
@@ -192,6 +187,30 @@
     return instance;
 }
 
++ (instancetype) loadFromData:(NSData *)data filter:(MTLoadFilter *)filter
+{
+    // Don't bother with anything that isn't a FAT file at all.
+    if ([data length] < sizeof(struct fat_header) || !MTFatFileHasMagic([data bytes]))
+        return nil;
+
+    MTFatFile *instance = [self loadFromData:data];
+
+    if (!instance || ![[instance membersMatchingFilter:filter] count])
+        return nil;
+
+    return instance;
+}
+
++ (instancetype) loadFromURL:(NSURL *)url filter:(MTLoadFilter *)filter
+{
+    MTFatFile *instance = [self loadFromURL:url];
+
+    if (!instance || ![[instance membersMatchingFilter:filter] count])
+        return nil;
+
+    return instance;
+}
+
 + (instancetype) loadFromURL:(NSURL *)url
 {
     MTFatFile *instance = [[MTFatFile alloc] init];
@@ -345,9 +364,18 @@
     if (size < totalSize)
         return -1;
 
+    // The entry format is the same for every entry, so the table is decoded in one go.
+    NSMutableData *decoded = [NSMutableData dataWithLength:(self->_header.nfat_arch * sizeof(struct fat_arch_64))];
+
+    if (!decoded)
+        return -1;
+
+    struct fat_arch_64 *entries = [decoded mutableBytes];
+    MTFatArchDecodeTable(buffer, self->_header.nfat_arch, [self is64bit], entries);
+
     for (NSUInteger i = 0; i < self->_header.nfat_arch; i++)
     {
-        MTFatFileEntryDescriptor *entry = [[MTFatFileEntryDescriptor alloc] initWithRawEntry:buffer + (i * advance) is64bit:[self is64bit]];
+        MTFatFileEntryDescriptor *entry = [[MTFatFileEntryDescriptor alloc] initWithEntry:&entries[i]];
         if (!entry) return -1;
 
         [self->_entries addObject:entry];
@@ -571,6 +599,39 @@
     }
 }
 
+- (NSArray<MTFatFileEntryDescriptor *> *) membersMatchingFilter:(MTLoadFilter *)filter
+{
+    NSMutableArray<MTFatFileEntryDescriptor *> *members = [[NSMutableArray alloc] initWithCapacity:[self->_entries count]];
+
+    for (MTFatFileEntryDescriptor *entry in self->_entries)
+    {
+        if ([filter acceptsMachineType:[entry type] subtype:[entry subtype]])
+            [members addObject:entry];
+    }
+
+    return members;
+}
+
+- (MTMachO *) imageForEntry:(MTFatFileEntryDescriptor *)entry filter:(MTLoadFilter *)filter
+{
+    // Check this before mapping anything.
+    if (filter && ![filter acceptsMachineType:[entry type] subtype:[entry subtype]])
+        return nil;
+
+    NSData *archive = [self dataForArchive];
+
+    if (!archive || [entry offset] + [entry size] > [archive length])
+        return nil;
+
+    // The deallocator keeps the archive mapping alive for as long as the image needs it.
+    void *bytes = (void *)((const UInt8 *)[archive bytes] + [entry offset]);
+    NSData *data = [[NSData alloc] initWithBytesNoCopy:bytes length:(NSUInteger)[entry size] deallocator:^(void *bytes, NSUInteger length) {
+        (void)archive;
+    }];
+
+    return [MTMachO loadFromData:data filter:filter];
+}
+
 - (BOOL) writeArchiveToStream:(NSOutputStream *)stream
 {
     NSInputStream *inputStream;
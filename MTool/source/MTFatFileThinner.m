@@ -0,0 +1,511 @@
+#import <MTool/MTool.h>
+#import <MTool/MTFatFileThinner.h>
+
+// For struct fat_header, struct fat_arch, etc.
+#import <mach-o/fat.h>
+
+// For open, pread, pwrite, mkstemp, rename
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/stat.h>
+
+// For mmap
+#import <sys/mman.h>
+
+// For fcopyfile
+#import <copyfile.h>
+
+// For handing out files to workers
+#import <stdatomic.h>
+
+// For MTFatArchDecoder
+#import "MTImageDecoder.h"
+
+// Nothing legitimate has more FAT entries than this. Java class files share FAT_MAGIC, and where a FAT file has
+//   its entry count they have their version (45 or more), so this also keeps us from touching them.
+#define kMTThinMaxFatEntries        32
+
+// Nor does anything need to be aligned past this (2^15, for 32K pages)
+#define kMTThinMaxAlignment         15
+
+// Thinning is almost all I/O, so start more workers than there are cores. The global queues bring up
+//   another thread whenever one blocks in the kernel, so these do end up running at the same time.
+#define kMTThinWorkersPerCore       4
+
+// Where a kept slice comes from in the original file and where it goes in the new one
+typedef struct {
+    struct fat_arch_64 entry;
+    UInt64 outputOffset;
+} MTThinSlice;
+
+// How well a slice suits the machine it's on, in the spirit of NXFindBestFatArch(). Higher is better.
+// 0 means the slice won't run here at all.
+static NSUInteger MTThinSliceRank(MTMachineType hostType, MTMachineSubtype hostSubtype, MTMachineType type, MTMachineSubtype subtype)
+{
+    if (type != hostType)
+        return 0;
+
+    hostSubtype &= ~kMTMachineCapabilitiesMask;
+    subtype &= ~kMTMachineCapabilitiesMask;
+
+    if (subtype == hostSubtype)
+        return 2;
+
+    // Otherwise, only the generic subtype is sure to run. (ex. arm64 on arm64e, x86_64 on x86_64h)
+    switch (type)
+    {
+        case kMTMachineTypeX86_64:  return (subtype == CPU_SUBTYPE_X86_64_ALL) ? 1 : 0;
+        case kMTMachineTypeAArch64: return (subtype == CPU_SUBTYPE_ARM64_ALL || subtype == CPU_SUBTYPE_ARM64_V8) ? 1 : 0;
+        case kMTMachineTypeI386:    return (subtype == CPU_SUBTYPE_I386_ALL) ? 1 : 0;
+        case kMTMachineTypeARM:     return (subtype == CPU_SUBTYPE_ARM_ALL) ? 1 : 0;
+        default:                    return 0;
+    }
+}
+
+static UInt64 MTRoundUp(UInt64 value, UInt64 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// pwrite() may write less than requested, so keep going until everything is out.
+static BOOL MTPositionedWrite(int fd, const void *buffer, size_t size, off_t offset)
+{
+    const UInt8 *bytes = (const UInt8 *)buffer;
+
+    while (size)
+    {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return NO;
+        }
+
+        bytes += written;
+        offset += written;
+        size -= written;
+    }
+
+    return YES;
+}
+
+// Likewise for pread(). Returns NO on error or if the file is too short.
+static BOOL MTPositionedRead(int fd, void *buffer, size_t size, off_t offset)
+{
+    UInt8 *bytes = (UInt8 *)buffer;
+
+    while (size)
+    {
+        ssize_t bytesRead = pread(fd, bytes, size, offset);
+
+        if (bytesRead <= 0)
+        {
+            if (bytesRead < 0 && errno == EINTR)
+                continue;
+
+            return NO;
+        }
+
+        bytes += bytesRead;
+        offset += bytesRead;
+        size -= bytesRead;
+    }
+
+    return YES;
+}
+
+@interface MTFatFileThinner (Private)
+
+// Write the kept slices to a new file next to `path`, then rename it over `path`.
+- (BOOL) replaceFileAtPath:(const char *)path source:(int)source info:(const struct stat *)info slices:(const MTThinSlice *)slices count:(NSUInteger)count is64bit:(BOOL)is64bit outputSize:(UInt64)outputSize;
+
+@end
+
+@implementation MTFatFileThinner
+{
+    // Set for the current machine. Only the one slice it would pick to run is kept.
+    BOOL _keepBestSlice;
+    MTMachineType _hostType;
+    MTMachineSubtype _hostSubtype;
+}
+
+@synthesize targets = _targets;
+@synthesize dryRun = _dryRun;
+
+- (instancetype) initWithTargets:(NSArray<MTLoadFilter *> *)targets
+{
+    self = [super init];
+
+    if (self)
+        self->_targets = [targets copy];
+
+    return self;
+}
+
++ (instancetype) thinnerForArchNames:(NSArray<NSString *> *)names
+{
+    NSMutableArray<MTLoadFilter *> *targets = [[NSMutableArray alloc] initWithCapacity:[names count]];
+
+    for (NSString *name in names)
+    {
+        MTMachineType type;
+        MTMachineSubtype subtype;
+
+        if (!MTMachinePairFromArchName(name, &type, &subtype))
+        {
+            NSLog(@"Unknown architecture '%@'!", name);
+
+            return nil;
+        }
+
+        MTLoadFilter *filter = [[MTLoadFilter alloc] init];
+        [filter setMachineType:type];
+        [filter setSubtype:subtype];
+
+        [targets addObject:filter];
+    }
+
+    return [[MTFatFileThinner alloc] initWithTargets:targets];
+}
+
++ (instancetype) thinnerForCurrentMachine
+{
+    MTMachineType type;
+    MTMachineSubtype subtype;
+
+    if (!MTMachinePairGetCurrent(&type, &subtype))
+        return nil;
+
+    // Matching the exact subtype would miss plain arm64 and x86_64 slices on arm64e and x86_64h machines,
+    //   so take any slice of this type here and pick the best one per file.
+    MTLoadFilter *filter = [[MTLoadFilter alloc] init];
+    [filter setMachineType:type];
+
+    MTFatFileThinner *thinner = [[MTFatFileThinner alloc] initWithTargets:@[filter]];
+    thinner->_keepBestSlice = YES;
+    thinner->_hostType = type;
+    thinner->_hostSubtype = subtype;
+
+    return thinner;
+}
+
+- (BOOL) wantsType:(MTMachineType)type subtype:(MTMachineSubtype)subtype
+{
+    for (MTLoadFilter *target in self->_targets)
+    {
+        if ([target acceptsMachineType:type subtype:subtype])
+            return YES;
+    }
+
+    return NO;
+}
+
+#pragma mark Thinning
+
+- (MTThinResult) thinFileAtURL:(NSURL *)url bytesSaved:(UInt64 *)saved
+{
+    const char *path = [[url path] fileSystemRepresentation];
+    MTThinResult result = kMTThinResultFailed;
+    MTThinSlice *slices = NULL;
+    UInt8 *entries = NULL;
+
+    if (saved)
+        (*saved) = 0;
+
+    // Symlinks are skipped. Whatever they point to is thinned on its own.
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        if (errno == ELOOP)
+            return kMTThinResultNotFat;
+
+        NSLog(@"Failed to open '%@'! (%s)", [url path], strerror(errno));
+
+        return kMTThinResultFailed;
+    }
+
+    struct stat info;
+    struct fat_header header;
+
+    // Most files in a tree aren't FAT files, so this is the only read most files get.
+    if (fstat(fd, &info) || !S_ISREG(info.st_mode) || info.st_size < (off_t)sizeof(struct fat_header) || !MTPositionedRead(fd, &header, sizeof(struct fat_header), 0))
+    {
+        result = kMTThinResultNotFat;
+
+        goto done;
+    }
+
+    UInt32 magic = MTSwapToHostEndian(header.magic);
+    UInt32 count = MTSwapToHostEndian(header.nfat_arch);
+
+    if (magic != FAT_MAGIC && magic != FAT_MAGIC_64)
+    {
+        result = kMTThinResultNotFat;
+
+        goto done;
+    }
+
+    if (count > kMTThinMaxFatEntries)
+    {
+        result = kMTThinResultNotFat;
+
+        goto done;
+    }
+
+    BOOL is64bit = (magic == FAT_MAGIC_64);
+    size_t entrySize = is64bit ? sizeof(struct fat_arch_64) : sizeof(struct fat_arch);
+    MTFatArchDecoder decode = is64bit ? MTFatArchDecode64 : MTFatArchDecode32;
+
+    entries = malloc(count * entrySize);
+    slices = calloc(count ? count : 1, sizeof(MTThinSlice));
+
+    if (!entries || !slices || !MTPositionedRead(fd, entries, count * entrySize, sizeof(struct fat_header)))
+    {
+        NSLog(@"Failed to read FAT entries from '%@'!", [url path]);
+
+        goto done;
+    }
+
+    NSUInteger kept = 0;
+    NSUInteger bestRank = 0;
+
+    for (UInt32 i = 0; i < count; i++)
+    {
+        struct fat_arch_64 entry;
+        decode(entries + (i * entrySize), &entry);
+
+        if (entry.offset + entry.size < entry.offset || entry.offset + entry.size > (UInt64)info.st_size || entry.align > kMTThinMaxAlignment)
+        {
+            NSLog(@"FAT entry %u in '%@' is malformed!", i, [url path]);
+
+            goto done;
+        }
+
+        if (![self wantsType:entry.cputype subtype:entry.cpusubtype])
+            continue;
+
+        if (self->_keepBestSlice) {
+            NSUInteger rank = MTThinSliceRank(self->_hostType, self->_hostSubtype, entry.cputype, entry.cpusubtype);
+
+            if (rank > bestRank)
+            {
+                slices[0].entry = entry;
+                bestRank = rank;
+                kept = 1;
+            }
+        } else {
+            slices[kept++].entry = entry;
+        }
+    }
+
+    if (!kept) {
+        result = kMTThinResultNoMatch;
+
+        goto done;
+    } else if (kept == count) {
+        result = kMTThinResultNothingToRemove;
+
+        goto done;
+    }
+
+    // A single slice becomes a thin image. Otherwise, lay the slices out again after a smaller header.
+    UInt64 outputSize;
+
+    if (kept == 1) {
+        slices[0].outputOffset = 0;
+        outputSize = slices[0].entry.size;
+    } else {
+        outputSize = sizeof(struct fat_header) + (kept * entrySize);
+
+        for (NSUInteger i = 0; i < kept; i++)
+        {
+            slices[i].outputOffset = MTRoundUp(outputSize, 1ULL << slices[i].entry.align);
+            outputSize = slices[i].outputOffset + slices[i].entry.size;
+        }
+    }
+
+    if (saved && outputSize < (UInt64)info.st_size)
+        (*saved) = (UInt64)info.st_size - outputSize;
+
+    if (self->_dryRun || [self replaceFileAtPath:path source:fd info:&info slices:slices count:kept is64bit:is64bit outputSize:outputSize]) {
+        result = kMTThinResultThinned;
+    } else {
+        if (saved)
+            (*saved) = 0;
+
+        NSLog(@"Failed to thin '%@'!", [url path]);
+    }
+
+done:
+    free(entries);
+    free(slices);
+    close(fd);
+
+    return result;
+}
+
+- (BOOL) replaceFileAtPath:(const char *)path source:(int)source info:(const struct stat *)info slices:(const MTThinSlice *)slices count:(NSUInteger)count is64bit:(BOOL)is64bit outputSize:(UInt64)outputSize
+{
+    // The new file has to be on the same volume for rename() to be atomic, so put it right next to the original.
+    NSString *originalPath = [[NSFileManager defaultManager] stringWithFileSystemRepresentation:path length:strlen(path)];
+    NSString *temporaryName = [NSString stringWithFormat:@".%@.thin.XXXXXX", [originalPath lastPathComponent]];
+    NSString *temporaryPath = [[originalPath stringByDeletingLastPathComponent] stringByAppendingPathComponent:temporaryName];
+
+    char *temporary = strdup([temporaryPath fileSystemRepresentation]);
+
+    if (!temporary)
+        return NO;
+
+    int output = mkstemp(temporary);
+
+    if (output < 0)
+    {
+        NSLog(@"Failed to create temporary file next to '%@'! (%s)", originalPath, strerror(errno));
+
+        free(temporary);
+        return NO;
+    }
+
+    BOOL result = NO;
+    void *map = MAP_FAILED;
+
+    // Any gaps between slices read back as zero.
+    if (ftruncate(output, (off_t)outputSize))
+        goto done;
+
+    if (count > 1)
+    {
+        size_t entrySize = is64bit ? sizeof(struct fat_arch_64) : sizeof(struct fat_arch);
+        size_t headerSize = sizeof(struct fat_header) + (count * entrySize);
+        UInt8 *headers = calloc(1, headerSize);
+
+        if (!headers)
+            goto done;
+
+        struct fat_header *fatHeader = (struct fat_header *)headers;
+        fatHeader->magic = MTSwapToBigEndian(is64bit ? FAT_MAGIC_64 : FAT_MAGIC);
+        fatHeader->nfat_arch = MTSwapToBigEndian((UInt32)count);
+
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            UInt8 *raw = headers + sizeof(struct fat_header) + (i * entrySize);
+
+            if (is64bit) {
+                struct fat_arch_64 *entry = (struct fat_arch_64 *)raw;
+
+                entry->cputype = MTSwapToBigEndian(slices[i].entry.cputype);
+                entry->cpusubtype = MTSwapToBigEndian(slices[i].entry.cpusubtype);
+                entry->offset = MTSwapToBigEndian64(slices[i].outputOffset);
+                entry->size = MTSwapToBigEndian64(slices[i].entry.size);
+                entry->align = MTSwapToBigEndian(slices[i].entry.align);
+            } else {
+                struct fat_arch *entry = (struct fat_arch *)raw;
+
+                // Slices only move towards the start of the file, so anything that fit in 32 bits still does.
+                entry->cputype = MTSwapToBigEndian(slices[i].entry.cputype);
+                entry->cpusubtype = MTSwapToBigEndian(slices[i].entry.cpusubtype);
+                entry->offset = MTSwapToBigEndian((UInt32)slices[i].outputOffset);
+                entry->size = MTSwapToBigEndian((UInt32)slices[i].entry.size);
+                entry->align = MTSwapToBigEndian(slices[i].entry.align);
+            }
+        }
+
+        BOOL wroteHeaders = MTPositionedWrite(output, headers, headerSize, 0);
+        free(headers);
+
+        if (!wroteHeaders)
+            goto done;
+    }
+
+    // There's no way to clone part of a file on macOS, so slices are written straight from a mapping of the original.
+    // The data goes from one file's pages to the other's without ever being copied into a buffer of ours.
+    map = mmap(NULL, (size_t)info->st_size, PROT_READ, MAP_SHARED, source, 0);
+
+    if (map == MAP_FAILED)
+        goto done;
+
+    madvise(map, (size_t)info->st_size, MADV_SEQUENTIAL);
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        if (!MTPositionedWrite(output, (const UInt8 *)map + slices[i].entry.offset, (size_t)slices[i].entry.size, (off_t)slices[i].outputOffset))
+            goto done;
+    }
+
+    // mkstemp() creates files 0600, so at least get the mode right before worrying about everything else.
+    if (fchmod(output, info->st_mode & 07777))
+        goto done;
+
+    // Ownership can only be copied as root, so don't fail over that. ACLs and extended attributes come along here too.
+    if (fcopyfile(source, output, NULL, COPYFILE_METADATA))
+        NSLog(@"Couldn't copy all metadata to thinned '%@'. (%s)", originalPath, strerror(errno));
+
+    if (rename(temporary, path))
+    {
+        NSLog(@"Failed to replace '%@'! (%s)", originalPath, strerror(errno));
+
+        goto done;
+    }
+
+    result = YES;
+
+done:
+    if (map != MAP_FAILED)
+        munmap(map, (size_t)info->st_size);
+
+    close(output);
+
+    if (!result)
+        unlink(temporary);
+
+    free(temporary);
+    return result;
+}
+
+- (UInt64) thinFilesAtURLs:(NSArray<NSURL *> *)urls handler:(void (^)(NSURL *, MTThinResult, UInt64))handler
+{
+    NSUInteger workerCount = MIN([[NSProcessInfo processInfo] activeProcessorCount] * kMTThinWorkersPerCore, [urls count]);
+
+    atomic_ulong nextFile = 0;
+    atomic_ullong totalSaved = 0;
+
+    atomic_ulong *next = &nextFile;
+    atomic_ullong *total = &totalSaved;
+
+    // dispatch_apply() never runs more iterations at once than there are cores, so start each worker on its own.
+    // Workers pull files off a shared counter, so nobody sits idle behind a large file.
+    dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+    dispatch_group_t group = dispatch_group_create();
+
+    for (NSUInteger i = 0; i < workerCount; i++)
+    {
+        dispatch_group_async(group, queue, ^{
+            NSUInteger index;
+
+            while ((index = atomic_fetch_add(next, 1)) < [urls count])
+            {
+                @autoreleasepool
+                {
+                    NSURL *url = [urls objectAtIndex:index];
+                    UInt64 saved = 0;
+
+                    MTThinResult result = [self thinFileAtURL:url bytesSaved:&saved];
+                    atomic_fetch_add(total, saved);
+
+                    if (handler)
+                        handler(url, result, saved);
+                }
+            }
+        });
+    }
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+    return atomic_load(&totalSaved);
+}
+
+@end
@@ -0,0 +1,95 @@
+// This is a private header. It is not exported from the MTool framework.
+#pragma once
+
+#import <Foundation/Foundation.h>
+#import <MTool/MTType.h>
+
+// For struct fat_arch, struct fat_arch_64
+#import <mach-o/fat.h>
+
+// A load command found by an MTImageDecoder. Everything here is host endian.
+typedef struct {
+    UInt32 cmd;
+    UInt32 cmdsize;
+
+    // Where the command starts, relative to the start of the image
+    size_t offset;
+
+    // Segments are decoded along with their sections. These are only set if `cmd` is the decoder's segment command.
+    struct segment_command_64 segment;
+    const struct section_64 *sections;
+} MTDecodedLoadCommand;
+
+// Every load command in an image, in order. Release these with MTDecodedLoadCommandsFree().
+typedef struct {
+    MTDecodedLoadCommand *commands;
+    UInt32 count;
+
+    // Backing storage for the sections of every segment
+    struct section_64 *sections;
+} MTDecodedLoadCommands;
+
+extern void MTDecodedLoadCommandsFree(MTDecodedLoadCommands *commands);
+
+// Mach-O images come in 4 flavors: (32 bit, 64 bit) x (native endian, swapped endian)
+// Rather than checking the word size and byte order for every field we read, we build one
+//   decoder for each combination at compile time (see MTImageDecoderTemplate.h) and pick
+//   which to use exactly once, when we see the image magic.
+// Every decoder widens the structures it reads to their 64 bit, host endian counterparts.
+// The load command walk (including segments and sections) is one call per image, so every read in it
+//   is inlined, and the native endian decoders compile it down to plain copies.
+// The single field readers are only for the odd value in other commands.
+typedef struct {
+    // Properties of the image this decoder handles
+    BOOL is64bit;
+    BOOL isSwapped;
+
+    // Size of `struct mach_header{,_64}` in the file
+    UInt32 headerSize;
+
+    // Either LC_SEGMENT or LC_SEGMENT_64, plus the matching in-file structure sizes
+    UInt32 segmentCommand;
+    UInt32 segmentCommandSize;
+    UInt32 sectionSize;
+
+    // Size of a pointer in the image (4 or 8)
+    UInt32 pointerSize;
+
+    // Size of a struct nlist{,_64} in the image
+    UInt32 symbolSize;
+
+    UInt32 (*read32)(const void *raw);
+    UInt64 (*read64)(const void *raw);
+
+    // Reads a 32 or 64 bit value, depending on the image pointer size.
+    UInt64 (*readPointer)(const void *raw);
+
+    void (*readHeader)(const void *raw, struct mach_header_64 *header);
+
+    // Decode every load command following `header` in one pass. `image` must hold the header and all of its commands.
+    // Returns NO (after logging why) if any command is malformed. On success, free `commands` when done with it.
+    BOOL (*readLoadCommands)(const void *image, const struct mach_header_64 *header, MTDecodedLoadCommands *commands);
+} MTImageDecoder;
+
+// Get the decoder for an image starting with the provided raw (in-file byte order) magic.
+// Returns NULL if this isn't a Mach-O magic value we recognize.
+extern const MTImageDecoder *MTImageDecoderForMagic(UInt32 magic);
+
+// Decode the header magic at the start of the provided buffer. This doesn't check the buffer size.
+static inline const MTImageDecoder *MTImageDecoderForImage(const void *image)
+{
+    UInt32 magic;
+    memcpy(&magic, image, sizeof(UInt32));
+
+    return MTImageDecoderForMagic(magic);
+}
+
+// FAT headers are always big endian, so these only need to be specialized on entry size.
+// They widen the entry in `raw` to a host endian fat_arch_64.
+typedef void (*MTFatArchDecoder)(const void *raw, struct fat_arch_64 *entry);
+
+extern void MTFatArchDecode32(const void *raw, struct fat_arch_64 *entry);
+extern void MTFatArchDecode64(const void *raw, struct fat_arch_64 *entry);
+
+// Decode a whole FAT entry table at once. The entry size is only looked at once, not per entry.
+extern void MTFatArchDecodeTable(const void *raw, UInt32 count, BOOL is64bit, struct fat_arch_64 *entries);
@@ -0,0 +1,114 @@
+#import <MTool/MTool.h>
+#import "MTImageDecoder.h"
+
+// For struct nlist, struct nlist_64
+#import <mach-o/nlist.h>
+
+// For OSSwapInt32, OSSwapInt64
+#import <libkern/OSByteOrder.h>
+
+#pragma mark - Mach-O decoder instantiations
+
+#define MT_DECODER_IS64 1
+#define MT_DECODER_SWAP 0
+#define MT_DECODER_NAME(n) MTDecoder64Native ## n
+#include "MTImageDecoderTemplate.h"
+#undef MT_DECODER_NAME
+#undef MT_DECODER_SWAP
+#undef MT_DECODER_IS64
+
+#define MT_DECODER_IS64 1
+#define MT_DECODER_SWAP 1
+#define MT_DECODER_NAME(n) MTDecoder64Swapped ## n
+#include "MTImageDecoderTemplate.h"
+#undef MT_DECODER_NAME
+#undef MT_DECODER_SWAP
+#undef MT_DECODER_IS64
+
+#define MT_DECODER_IS64 0
+#define MT_DECODER_SWAP 0
+#define MT_DECODER_NAME(n) MTDecoder32Native ## n
+#include "MTImageDecoderTemplate.h"
+#undef MT_DECODER_NAME
+#undef MT_DECODER_SWAP
+#undef MT_DECODER_IS64
+
+#define MT_DECODER_IS64 0
+#define MT_DECODER_SWAP 1
+#define MT_DECODER_NAME(n) MTDecoder32Swapped ## n
+#include "MTImageDecoderTemplate.h"
+#undef MT_DECODER_NAME
+#undef MT_DECODER_SWAP
+#undef MT_DECODER_IS64
+
+const MTImageDecoder *MTImageDecoderForMagic(UInt32 magic)
+{
+    // The magic is read in file byte order, so a *_CIGAM value means the image is swapped.
+    switch (magic)
+    {
+        case MH_MAGIC_64:   return &MTDecoder64NativeDecoder;
+        case MH_CIGAM_64:   return &MTDecoder64SwappedDecoder;
+        case MH_MAGIC:      return &MTDecoder32NativeDecoder;
+        case MH_CIGAM:      return &MTDecoder32SwappedDecoder;
+        default:            return NULL;
+    }
+}
+
+void MTDecodedLoadCommandsFree(MTDecodedLoadCommands *commands)
+{
+    free(commands->commands);
+    free(commands->sections);
+
+    memset(commands, 0, sizeof(MTDecodedLoadCommands));
+}
+
+#pragma mark - FAT entry decoders
+
+static inline void MTFatArchRead32(const void *raw, struct fat_arch_64 *entry)
+{
+    struct fat_arch in;
+    memcpy(&in, raw, sizeof(in));
+
+    entry->cputype      = MTSwapToHostEndian(in.cputype);
+    entry->cpusubtype   = MTSwapToHostEndian(in.cpusubtype);
+    entry->offset       = MTSwapToHostEndian(in.offset);
+    entry->size         = MTSwapToHostEndian(in.size);
+    entry->align        = MTSwapToHostEndian(in.align);
+    entry->reserved     = 0;
+}
+
+static inline void MTFatArchRead64(const void *raw, struct fat_arch_64 *entry)
+{
+    struct fat_arch_64 in;
+    memcpy(&in, raw, sizeof(in));
+
+    entry->cputype      = MTSwapToHostEndian(in.cputype);
+    entry->cpusubtype   = MTSwapToHostEndian(in.cpusubtype);
+    entry->offset       = MTSwapToHostEndian64(in.offset);
+    entry->size         = MTSwapToHostEndian64(in.size);
+    entry->align        = MTSwapToHostEndian(in.align);
+    entry->reserved     = MTSwapToHostEndian(in.reserved);
+}
+
+void MTFatArchDecode32(const void *raw, struct fat_arch_64 *entry)
+{
+    MTFatArchRead32(raw, entry);
+}
+
+void MTFatArchDecode64(const void *raw, struct fat_arch_64 *entry)
+{
+    MTFatArchRead64(raw, entry);
+}
+
+void MTFatArchDecodeTable(const void *raw, UInt32 count, BOOL is64bit, struct fat_arch_64 *entries)
+{
+    const UInt8 *bytes = (const UInt8 *)raw;
+
+    if (is64bit) {
+        for (UInt32 i = 0; i < count; i++)
+            MTFatArchRead64(bytes + (i * sizeof(struct fat_arch_64)), &entries[i]);
+    } else {
+        for (UInt32 i = 0; i < count; i++)
+            MTFatArchRead32(bytes + (i * sizeof(struct fat_arch)), &entries[i]);
+    }
+}
@@ -0,0 +1,272 @@
+// This is a private header. It is not exported from the MTool framework.
+// Note: There is intentionally no include guard here. Use #include (not #import) for this file.
+
+// This file is the "template" body for a single Mach-O decoder. MTImageDecoder.m includes it
+//   once per (word size, byte order) pair with the following macros set:
+//   - MT_DECODER_IS64: 1 if this decoder handles 64 bit images, 0 otherwise
+//   - MT_DECODER_SWAP: 1 if the image byte order differs from the host, 0 otherwise
+//   - MT_DECODER_NAME(n): Produces a unique symbol name for `n` in this instantiation
+// Everything here is decided by the preprocessor, so no decoder branches on either property.
+
+#if !defined(MT_DECODER_IS64) || !defined(MT_DECODER_SWAP) || !defined(MT_DECODER_NAME)
+#error "MTImageDecoderTemplate.h included without instantiation parameters!"
+#endif
+
+#if MT_DECODER_SWAP
+#define MT_DECODE32(v) OSSwapInt32(v)
+#define MT_DECODE64(v) OSSwapInt64(v)
+#else
+#define MT_DECODE32(v) (v)
+#define MT_DECODE64(v) (v)
+#endif
+
+#if MT_DECODER_IS64
+typedef struct mach_header_64          MT_DECODER_NAME(Header);
+typedef struct segment_command_64      MT_DECODER_NAME(Segment);
+typedef struct section_64              MT_DECODER_NAME(Section);
+typedef struct nlist_64                MT_DECODER_NAME(Symbol);
+#define MT_DECODE_WORD(v)              MT_DECODE64(v)
+#define MT_SEGMENT_COMMAND             LC_SEGMENT_64
+#define MT_OTHER_SEGMENT_COMMAND       LC_SEGMENT
+#else
+typedef struct mach_header             MT_DECODER_NAME(Header);
+typedef struct segment_command         MT_DECODER_NAME(Segment);
+typedef struct section                 MT_DECODER_NAME(Section);
+typedef struct nlist                   MT_DECODER_NAME(Symbol);
+#define MT_DECODE_WORD(v)              MT_DECODE32(v)
+#define MT_SEGMENT_COMMAND             LC_SEGMENT
+#define MT_OTHER_SEGMENT_COMMAND       LC_SEGMENT_64
+#endif
+
+// Note: Everything is copied out with memcpy() since mapped images don't guarentee alignment.
+
+static inline UInt32 MT_DECODER_NAME(Read32)(const void *raw)
+{
+    UInt32 value;
+    memcpy(&value, raw, sizeof(UInt32));
+
+    return MT_DECODE32(value);
+}
+
+static inline UInt64 MT_DECODER_NAME(Read64)(const void *raw)
+{
+    UInt64 value;
+    memcpy(&value, raw, sizeof(UInt64));
+
+    return MT_DECODE64(value);
+}
+
+static inline UInt64 MT_DECODER_NAME(ReadPointer)(const void *raw)
+{
+#if MT_DECODER_IS64
+    return MT_DECODER_NAME(Read64)(raw);
+#else
+    return MT_DECODER_NAME(Read32)(raw);
+#endif
+}
+
+static inline void MT_DECODER_NAME(ReadHeader)(const void *raw, struct mach_header_64 *header)
+{
+    MT_DECODER_NAME(Header) in;
+    memcpy(&in, raw, sizeof(in));
+
+    header->magic       = MT_DECODE32(in.magic);
+    header->cputype     = MT_DECODE32(in.cputype);
+    header->cpusubtype  = MT_DECODE32(in.cpusubtype);
+    header->filetype    = MT_DECODE32(in.filetype);
+    header->ncmds       = MT_DECODE32(in.ncmds);
+    header->sizeofcmds  = MT_DECODE32(in.sizeofcmds);
+    header->flags       = MT_DECODE32(in.flags);
+
+#if MT_DECODER_IS64
+    header->reserved    = MT_DECODE32(in.reserved);
+#else
+    header->reserved    = 0;
+#endif
+}
+
+static inline void MT_DECODER_NAME(ReadLoadCommand)(const void *raw, struct load_command *command)
+{
+    struct load_command in;
+    memcpy(&in, raw, sizeof(in));
+
+    command->cmd        = MT_DECODE32(in.cmd);
+    command->cmdsize    = MT_DECODE32(in.cmdsize);
+}
+
+static inline void MT_DECODER_NAME(ReadSegment)(const void *raw, struct segment_command_64 *segment)
+{
+    MT_DECODER_NAME(Segment) in;
+    memcpy(&in, raw, sizeof(in));
+
+    segment->cmd        = MT_DECODE32(in.cmd);
+    segment->cmdsize    = MT_DECODE32(in.cmdsize);
+    memcpy(segment->segname, in.segname, sizeof(segment->segname));
+
+    segment->vmaddr     = MT_DECODE_WORD(in.vmaddr);
+    segment->vmsize     = MT_DECODE_WORD(in.vmsize);
+    segment->fileoff    = MT_DECODE_WORD(in.fileoff);
+    segment->filesize   = MT_DECODE_WORD(in.filesize);
+
+    segment->maxprot    = MT_DECODE32(in.maxprot);
+    segment->initprot   = MT_DECODE32(in.initprot);
+    segment->nsects     = MT_DECODE32(in.nsects);
+    segment->flags      = MT_DECODE32(in.flags);
+}
+
+static inline void MT_DECODER_NAME(ReadSection)(const void *raw, struct section_64 *section)
+{
+    MT_DECODER_NAME(Section) in;
+    memcpy(&in, raw, sizeof(in));
+
+    memcpy(section->sectname, in.sectname, sizeof(section->sectname));
+    memcpy(section->segname, in.segname, sizeof(section->segname));
+
+    section->addr       = MT_DECODE_WORD(in.addr);
+    section->size       = MT_DECODE_WORD(in.size);
+
+    section->offset     = MT_DECODE32(in.offset);
+    section->align      = MT_DECODE32(in.align);
+    section->reloff     = MT_DECODE32(in.reloff);
+    section->nreloc     = MT_DECODE32(in.nreloc);
+    section->flags      = MT_DECODE32(in.flags);
+    section->reserved1  = MT_DECODE32(in.reserved1);
+    section->reserved2  = MT_DECODE32(in.reserved2);
+
+#if MT_DECODER_IS64
+    section->reserved3  = MT_DECODE32(in.reserved3);
+#else
+    section->reserved3  = 0;
+#endif
+}
+
+// Everything here calls the readers above directly, so this is the only indirect call made per image.
+static BOOL MT_DECODER_NAME(ReadLoadCommands)(const void *image, const struct mach_header_64 *header, MTDecodedLoadCommands *result)
+{
+    const UInt8 *base = (const UInt8 *)image;
+    size_t commandsEnd = sizeof(MT_DECODER_NAME(Header)) + (size_t)header->sizeofcmds;
+    size_t offset = sizeof(MT_DECODER_NAME(Header));
+    size_t sectionCount = 0;
+
+    memset(result, 0, sizeof(MTDecodedLoadCommands));
+
+    // Every command takes up at least a struct load_command. This also keeps a corrupt count from making us allocate gigabytes.
+    if (header->ncmds > header->sizeofcmds / sizeof(struct load_command))
+    {
+        NSLog(@"Found load commands past end of expected section!");
+
+        return NO;
+    }
+
+    // Sections live inside their segment commands, so no more than this can fit.
+    size_t maxSections = header->sizeofcmds / sizeof(MT_DECODER_NAME(Section));
+
+    result->commands = calloc(header->ncmds ? header->ncmds : 1, sizeof(MTDecodedLoadCommand));
+    result->sections = calloc(maxSections ? maxSections : 1, sizeof(struct section_64));
+
+    if (!result->commands || !result->sections)
+    {
+        NSLog(@"Out of memory!");
+
+        goto fail;
+    }
+
+    for (UInt32 i = 0; i < header->ncmds; i++)
+    {
+        MTDecodedLoadCommand *command = &result->commands[i];
+
+        if (offset + sizeof(struct load_command) > commandsEnd)
+        {
+            NSLog(@"Found load commands past end of expected section!");
+
+            goto fail;
+        }
+
+        struct load_command loadCommand;
+        MT_DECODER_NAME(ReadLoadCommand)(base + offset, &loadCommand);
+
+        if (offset + loadCommand.cmdsize > commandsEnd || loadCommand.cmdsize < sizeof(struct load_command))
+        {
+            NSLog(@"Found command with too small/large size in image!");
+
+            goto fail;
+        }
+
+        command->cmd = loadCommand.cmd;
+        command->cmdsize = loadCommand.cmdsize;
+        command->offset = offset;
+
+        // A 32 bit image with LC_SEGMENT_64 (or vice versa) is malformed.
+        if (loadCommand.cmd == MT_OTHER_SEGMENT_COMMAND)
+        {
+            NSLog(@"Found segment command of wrong width in image!");
+
+            goto fail;
+        }
+
+        if (loadCommand.cmd == MT_SEGMENT_COMMAND)
+        {
+            if (loadCommand.cmdsize < sizeof(MT_DECODER_NAME(Segment)))
+            {
+                NSLog(@"Found undersized segment command in image!");
+
+                goto fail;
+            }
+
+            MT_DECODER_NAME(ReadSegment)(base + offset, &command->segment);
+
+            if (sizeof(MT_DECODER_NAME(Segment)) + ((UInt64)command->segment.nsects * sizeof(MT_DECODER_NAME(Section))) > loadCommand.cmdsize)
+            {
+                NSLog(@"Segment '%.16s' has more sections than fit in its command!", command->segment.segname);
+
+                goto fail;
+            }
+
+            const UInt8 *rawSections = base + offset + sizeof(MT_DECODER_NAME(Segment));
+            command->sections = &result->sections[sectionCount];
+
+            for (UInt32 j = 0; j < command->segment.nsects; j++)
+                MT_DECODER_NAME(ReadSection)(rawSections + (j * sizeof(MT_DECODER_NAME(Section))), &result->sections[sectionCount++]);
+        }
+
+        offset += loadCommand.cmdsize;
+    }
+
+    result->count = header->ncmds;
+    return YES;
+
+fail:
+    MTDecodedLoadCommandsFree(result);
+    return NO;
+}
+
+static const MTImageDecoder MT_DECODER_NAME(Decoder) = {
+    .is64bit            = MT_DECODER_IS64,
+    .isSwapped          = MT_DECODER_SWAP,
+
+    .headerSize         = sizeof(MT_DECODER_NAME(Header)),
+
+#if MT_DECODER_IS64
+    .segmentCommand     = LC_SEGMENT_64,
+#else
+    .segmentCommand     = LC_SEGMENT,
+#endif
+    .segmentCommandSize = sizeof(MT_DECODER_NAME(Segment)),
+    .sectionSize        = sizeof(MT_DECODER_NAME(Section)),
+
+    .pointerSize        = (MT_DECODER_IS64 ? 8 : 4),
+    .symbolSize         = sizeof(MT_DECODER_NAME(Symbol)),
+
+    .read32             = MT_DECODER_NAME(Read32),
+    .read64             = MT_DECODER_NAME(Read64),
+    .readPointer        = MT_DECODER_NAME(ReadPointer),
+
+    .readHeader         = MT_DECODER_NAME(ReadHeader),
+    .readLoadCommands   = MT_DECODER_NAME(ReadLoadCommands)
+};
+
+#undef MT_OTHER_SEGMENT_COMMAND
+#undef MT_SEGMENT_COMMAND
+#undef MT_DECODE_WORD
+#undef MT_DECODE64
+#undef MT_DECODE32
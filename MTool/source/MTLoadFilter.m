@@ -0,0 +1,179 @@
+#import <MTool/MTool.h>
+#import <MTool/MTLoadFilter.h>
+
+#import <mach-o/loader.h>
+
+// Every load command in use fits here once LC_REQ_DYLD is masked off. Anything else goes in a set.
+#define kMTLoadFilterCommandBits 128
+
+// Commands with LC_REQ_DYLD set get their own bitmap, so (ex.) LC_DYLD_INFO and LC_DYLD_INFO_ONLY stay distinct.
+#define MTLoadFilterBitmapIndex(command) (((command) & LC_REQ_DYLD) ? 1 : 0)
+
+// Names are stored as they appear in the image, so comparisons are just strncmp.
+typedef struct {
+    char segment[16];
+    char section[16];
+} MTLoadFilterSection;
+
+static void MTLoadFilterCopyName(char name[16], NSString *string)
+{
+    memset(name, 0, 16);
+    strncpy(name, [string UTF8String], 16);
+}
+
+@implementation MTLoadFilter
+{
+    UInt64 _commandBits[2][kMTLoadFilterCommandBits / 64];
+    NSMutableSet<NSNumber *> *_commands;
+
+    // There are only ever a handful of these, so they're just searched linearly.
+    NSMutableData *_sections;
+}
+
+@synthesize machineType = _machineType;
+@synthesize subtype = _subtype;
+
+@synthesize wantsAllLoadCommands = _wantsAllLoadCommands;
+
+@dynamic loadCommands;
+
+- (instancetype) init
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->_machineType = kMTMachineTypeAny;
+        self->_subtype = CPU_SUBTYPE_MULTIPLE;
+
+        self->_commands = [[NSMutableSet alloc] init];
+        self->_sections = [[NSMutableData alloc] init];
+    }
+
+    return self;
+}
+
++ (instancetype) filterForAllLoadCommands
+{
+    MTLoadFilter *filter = [[MTLoadFilter alloc] init];
+    [filter addAllLoadCommands];
+
+    return filter;
+}
+
+#pragma mark Building filters
+
+- (NSSet<NSNumber *> *) loadCommands
+{
+    return [self->_commands copy];
+}
+
+- (void) addLoadCommand:(UInt32)command
+{
+    UInt32 bit = (command & ~LC_REQ_DYLD);
+
+    if (bit < kMTLoadFilterCommandBits)
+        self->_commandBits[MTLoadFilterBitmapIndex(command)][bit / 64] |= (1ULL << (bit % 64));
+
+    [self->_commands addObject:@(command)];
+}
+
+- (void) addAllLoadCommands
+{
+    self->_wantsAllLoadCommands = YES;
+}
+
+- (void) addSectionNamed:(NSString *)section inSegment:(NSString *)segment
+{
+    MTLoadFilterSection entry;
+
+    MTLoadFilterCopyName(entry.segment, segment);
+    MTLoadFilterCopyName(entry.section, section);
+
+    [self->_sections appendBytes:&entry length:sizeof(MTLoadFilterSection)];
+}
+
+- (void) addRequirementsFromFilter:(MTLoadFilter *)filter
+{
+    if (filter->_wantsAllLoadCommands)
+        self->_wantsAllLoadCommands = YES;
+
+    for (NSNumber *command in filter->_commands)
+        [self addLoadCommand:[command unsignedIntValue]];
+
+    [self->_sections appendData:filter->_sections];
+}
+
+#pragma mark Queries
+
+- (BOOL) acceptsMachineType:(MTMachineType)type subtype:(MTMachineSubtype)subtype
+{
+    if (self->_machineType == kMTMachineTypeAny)
+        return YES;
+
+    if (self->_machineType != type)
+        return NO;
+
+    if (self->_subtype == CPU_SUBTYPE_MULTIPLE)
+        return YES;
+
+    return ((self->_subtype & ~kMTMachineCapabilitiesMask) == (subtype & ~kMTMachineCapabilitiesMask));
+}
+
+- (BOOL) wantsLoadCommand:(UInt32)command
+{
+    if (self->_wantsAllLoadCommands)
+        return YES;
+
+    UInt32 bit = (command & ~LC_REQ_DYLD);
+
+    if (bit < kMTLoadFilterCommandBits) {
+        return !!(self->_commandBits[MTLoadFilterBitmapIndex(command)][bit / 64] & (1ULL << (bit % 64)));
+    } else {
+        return [self->_commands containsObject:@(command)];
+    }
+}
+
+- (BOOL) wantsSegmentNamed:(const char *)name
+{
+    const MTLoadFilterSection *sections = [self->_sections bytes];
+    NSUInteger count = [self->_sections length] / sizeof(MTLoadFilterSection);
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        if (!strncmp(sections[i].segment, name, 16))
+            return YES;
+    }
+
+    return NO;
+}
+
+- (BOOL) wantsSectionNamed:(const char *)section inSegment:(const char *)segment
+{
+    // Asking for the segment command itself means every section in it.
+    if ([self wantsLoadCommand:LC_SEGMENT] || [self wantsLoadCommand:LC_SEGMENT_64])
+        return YES;
+
+    const MTLoadFilterSection *sections = [self->_sections bytes];
+    NSUInteger count = [self->_sections length] / sizeof(MTLoadFilterSection);
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        if (!strncmp(sections[i].segment, segment, 16) && !strncmp(sections[i].section, section, 16))
+            return YES;
+    }
+
+    return NO;
+}
+
+- (NSString *) description
+{
+    NSMutableArray<NSString *> *commands = [[NSMutableArray alloc] init];
+
+    for (NSNumber *command in self->_commands)
+        [commands addObject:MTMachOLoadCommandName([command unsignedIntValue])];
+
+    return [NSString stringWithFormat:@"<MTLoadFilter arch=%@ commands=%@ sections=%lu>", (self->_machineType == kMTMachineTypeAny) ? @"any" : MTMachinePairToArchName(self->_machineType, self->_subtype), self->_wantsAllLoadCommands ? @"all" : [commands componentsJoinedByString:@","], (unsigned long)([self->_sections length] / sizeof(MTLoadFilterSection))];
+}
+
+@end
@@ -8,7 +8,675 @@
 #import <mach/machine.h>
 #import <mach/vm_map.h>
 
+#import "MTMachOPrivate.h"
+
+// Names in images are almost always UTF-8, but nothing enforces it. Fall back to Latin-1 rather than
+//   returning nil, since every byte sequence is valid there and nothing is lost.
+static NSString *MTMachOString(const void *bytes, NSUInteger length)
+{
+    return [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding]
+        ?: [[NSString alloc] initWithBytes:bytes length:length encoding:NSISOLatin1StringEncoding]
+        ?: @"";
+}
+
+#pragma mark - Load Command Objects
+
+@implementation MTLoadCommand
+{
+    // Images own their commands, not the other way around.
+    __weak MTMachO *_image;
+
+    NSRange _range;
+}
+
+@synthesize type = _type;
+
+@dynamic rawCommandData;
+@dynamic image;
+
+- (instancetype) initWithImage:(MTMachO *)image type:(UInt32)type range:(NSRange)range
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->_image = image;
+        self->_type = type;
+        self->_range = range;
+    }
+
+    return self;
+}
+
+- (MTMachO *) image
+{
+    return self->_image;
+}
+
+- (NSRange) range
+{
+    return self->_range;
+}
+
+- (const UInt8 *) rawCommand
+{
+    return (const UInt8 *)[[self->_image imageData] bytes] + self->_range.location;
+}
+
+- (NSData *) rawCommandData
+{
+    return [[self->_image imageData] subdataWithRange:self->_range];
+}
+
+@end
+
+@interface MTSectionInfo (Private)
+
+- (instancetype) initWithSection:(const struct section_64 *)section;
+
+@end
+
+@interface MTSegmentInfo (Private)
+
+// Segments are decoded along with the rest of the load commands. See MTImageDecoder.
+- (instancetype) initWithImage:(MTMachO *)image range:(NSRange)range segment:(const struct segment_command_64 *)segment sections:(const struct section_64 *)sections;
+
+@end
+
+@implementation MTSectionInfo
+{
+    struct section_64 _underlying;
+}
+
+@dynamic segmentName;
+@dynamic name;
+
+@dynamic address;
+@dynamic size;
+@dynamic fileOffset;
+@dynamic alignment;
+
+@dynamic relocationOffset;
+@dynamic relocationCount;
+
+@dynamic flags;
+@dynamic sectionType;
+
+- (instancetype) initWithSection:(const struct section_64 *)section
+{
+    self = [super init];
+
+    if (self)
+        self->_underlying = (*section);
+
+    return self;
+}
+
+- (NSString *) segmentName
+{
+    return MTMachOString(self->_underlying.segname, strnlen(self->_underlying.segname, 16));
+}
+
+- (NSString *) name
+{
+    return MTMachOString(self->_underlying.sectname, strnlen(self->_underlying.sectname, 16));
+}
+
+- (UInt64) address
+{
+    return self->_underlying.addr;
+}
+
+- (UInt64) size
+{
+    return self->_underlying.size;
+}
+
+- (UInt32) fileOffset
+{
+    return self->_underlying.offset;
+}
+
+- (UInt32) alignment
+{
+    return self->_underlying.align;
+}
+
+- (UInt32) relocationOffset
+{
+    return self->_underlying.reloff;
+}
+
+- (UInt32) relocationCount
+{
+    return self->_underlying.nreloc;
+}
+
+- (UInt32) flags
+{
+    return self->_underlying.flags;
+}
+
+- (UInt32) sectionType
+{
+    return (self->_underlying.flags & SECTION_TYPE);
+}
+
+@end
+
+@implementation MTSegmentInfo
+{
+    struct segment_command_64 _underlying;
+
+    NSArray<MTSectionInfo *> *_sections;
+}
+
+@dynamic name;
+
+@dynamic vmAddress;
+@dynamic vmSize;
+@dynamic fileOffset;
+@dynamic fileSize;
+
+@dynamic maxProtection;
+@dynamic initialProtection;
+@dynamic flags;
+
+@dynamic sections;
+
+- (instancetype) initWithImage:(MTMachO *)image range:(NSRange)range segment:(const struct segment_command_64 *)segment sections:(const struct section_64 *)sections
+{
+    self = [super initWithImage:image type:segment->cmd range:range];
+
+    if (self)
+    {
+        NSMutableArray<MTSectionInfo *> *sectionInfo = [[NSMutableArray alloc] initWithCapacity:segment->nsects];
+        MTLoadFilter *filter = [image filter];
+
+        self->_underlying = (*segment);
+
+        for (UInt32 i = 0; i < segment->nsects; i++)
+        {
+            if (filter && ![filter wantsSectionNamed:sections[i].sectname inSegment:segment->segname])
+                continue;
+
+            [sectionInfo addObject:[[MTSectionInfo alloc] initWithSection:&sections[i]]];
+        }
+
+        self->_sections = [sectionInfo copy];
+    }
+
+    return self;
+}
+
+- (NSString *) name
+{
+    return MTMachOString(self->_underlying.segname, strnlen(self->_underlying.segname, 16));
+}
+
+- (UInt64) vmAddress
+{
+    return self->_underlying.vmaddr;
+}
+
+- (UInt64) vmSize
+{
+    return self->_underlying.vmsize;
+}
+
+- (UInt64) fileOffset
+{
+    return self->_underlying.fileoff;
+}
+
+- (UInt64) fileSize
+{
+    return self->_underlying.filesize;
+}
+
+- (vm_prot_t) maxProtection
+{
+    return self->_underlying.maxprot;
+}
+
+- (vm_prot_t) initialProtection
+{
+    return self->_underlying.initprot;
+}
+
+- (UInt32) flags
+{
+    return self->_underlying.flags;
+}
+
+- (NSArray<MTSectionInfo *> *) sections
+{
+    return self->_sections;
+}
+
+@end
+
+@implementation MTDylibInfo
+
+@dynamic image;
+
+@synthesize referenceType = _referenceType;
+@synthesize name = _name;
+
+- (instancetype) initWithImage:(MTMachO *)image type:(UInt32)type range:(NSRange)range
+{
+    self = [super initWithImage:image type:type range:range];
+
+    if (self)
+    {
+        const MTImageDecoder *decoder = [image decoder];
+        const UInt8 *raw = [self rawCommand];
+
+        if (range.length < sizeof(struct dylib_command))
+        {
+            NSLog(@"Found undersized dylib command in image!");
+
+            return nil;
+        }
+
+        UInt32 nameOffset = decoder->read32(raw + offsetof(struct dylib_command, dylib.name));
+
+        if (nameOffset >= range.length)
+        {
+            NSLog(@"Found dylib command with name outside of command!");
+
+            return nil;
+        }
+
+        self->_name = MTMachOString(raw + nameOffset, strnlen((const char *)(raw + nameOffset), range.length - nameOffset));
+
+        switch (type)
+        {
+            case LC_LOAD_WEAK_DYLIB:    self->_referenceType = MTDylibReferenceTypeWeak;        break;
+            case LC_REEXPORT_DYLIB:     self->_referenceType = MTDylibReferenceTypeReexport;    break;
+            case LC_LOAD_UPWARD_DYLIB:  self->_referenceType = MTDylibReferenceTypeUpward;      break;
+            default:                    self->_referenceType = kMTDylibReferenceTypeRegular;    break;
+        }
+    }
+
+    return self;
+}
+
+- (MTMachO *) image
+{
+    // Referenced libraries aren't resolved yet. Don't hand back the image this command came from.
+    return nil;
+}
+
+@end
+
+@implementation MTBuildVersionInfo
+
+@synthesize platform = _platform;
+@synthesize minimumVersion = _minimumVersion;
+@synthesize sdkVersion = _sdkVersion;
+
+- (instancetype) initWithImage:(MTMachO *)image type:(UInt32)type range:(NSRange)range
+{
+    self = [super initWithImage:image type:type range:range];
+
+    if (self)
+    {
+        const MTImageDecoder *decoder = [image decoder];
+        const UInt8 *raw = [self rawCommand];
+
+        if (type == LC_BUILD_VERSION)
+        {
+            if (range.length < sizeof(struct build_version_command))
+            {
+                NSLog(@"Found undersized build version command in image!");
+
+                return nil;
+            }
+
+            self->_platform = decoder->read32(raw + offsetof(struct build_version_command, platform));
+            self->_minimumVersion = decoder->read32(raw + offsetof(struct build_version_command, minos));
+            self->_sdkVersion = decoder->read32(raw + offsetof(struct build_version_command, sdk));
+
+            return self;
+        }
+
+        if (range.length < sizeof(struct version_min_command))
+        {
+            NSLog(@"Found undersized version min command in image!");
+
+            return nil;
+        }
+
+        switch (type)
+        {
+            case LC_VERSION_MIN_MACOSX:     self->_platform = PLATFORM_MACOS;   break;
+            case LC_VERSION_MIN_IPHONEOS:   self->_platform = PLATFORM_IOS;     break;
+            case LC_VERSION_MIN_TVOS:       self->_platform = PLATFORM_TVOS;    break;
+            case LC_VERSION_MIN_WATCHOS:    self->_platform = PLATFORM_WATCHOS; break;
+        }
+
+        self->_minimumVersion = decoder->read32(raw + offsetof(struct version_min_command, version));
+        self->_sdkVersion = decoder->read32(raw + offsetof(struct version_min_command, sdk));
+    }
+
+    return self;
+}
+
+@end
+
+@implementation MTLinkerOptionInfo
+
+@synthesize options = _options;
+
+- (instancetype) initWithImage:(MTMachO *)image type:(UInt32)type range:(NSRange)range
+{
+    self = [super initWithImage:image type:type range:range];
+
+    if (self)
+    {
+        const MTImageDecoder *decoder = [image decoder];
+        const UInt8 *raw = [self rawCommand];
+
+        if (range.length < sizeof(struct linker_option_command))
+        {
+            NSLog(@"Found undersized linker option command in image!");
+
+            return nil;
+        }
+
+        UInt32 count = decoder->read32(raw + offsetof(struct linker_option_command, count));
+
+        // Each option is at least a NUL, so this bounds the count before we allocate anything.
+        if (count > range.length - sizeof(struct linker_option_command))
+        {
+            NSLog(@"Linker option command claims more options than fit in it!");
+
+            return nil;
+        }
+
+        NSMutableArray<NSString *> *options = [[NSMutableArray alloc] initWithCapacity:count];
+        NSUInteger offset = sizeof(struct linker_option_command);
+
+        for (UInt32 i = 0; i < count; i++)
+        {
+            size_t length = strnlen((const char *)(raw + offset), range.length - offset);
+
+            if (offset + length >= range.length)
+            {
+                NSLog(@"Found unterminated linker option in image!");
+
+                return nil;
+            }
+
+            [options addObject:MTMachOString(raw + offset, length)];
+            offset += length + 1;
+        }
+
+        self->_options = [options copy];
+    }
+
+    return self;
+}
+
+@end
+
+#pragma mark - Mach-O main class
+
 @implementation MTMachO
+{
+    // Backing storage for this image. If this is a mapped file, this keeps the mapping alive.
+    NSData *_data;
+
+    // Chosen once from the image magic. Everything in the image is read through this.
+    const MTImageDecoder *_decoder;
+
+    // This is stored decoded to host endian and widened to 64 bits.
+    struct mach_header_64 _header;
+
+    NSArray<MTLoadCommand *> *_loadCommands;
+
+    // If set, only what this asks for is decoded.
+    MTLoadFilter *_filter;
+}
+
+@dynamic is64bit;
+@dynamic isSwapped;
+
+@dynamic type;
+@dynamic machineType;
+@dynamic subtype;
+
+@dynamic allLoadCommands;
+@dynamic segments;
+@dynamic filter;
+
+#pragma mark Loading Images
+
++ (instancetype) loadFromMemoryAt:(void *)location maxSize:(NSUInteger)size
+{
+    return [self loadFromData:[NSData dataWithBytesNoCopy:location length:size freeWhenDone:NO]];
+}
+
++ (instancetype) loadFromURL:(NSURL *)url
+{
+    return [self loadFromURL:url filter:nil];
+}
+
++ (instancetype) loadFromData:(NSData *)data
+{
+    return [self loadFromData:data filter:nil];
+}
+
++ (instancetype) loadFromURL:(NSURL *)url filter:(MTLoadFilter *)filter
+{
+    NSError *error;
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:&error];
+
+    if (!data)
+    {
+        NSLog(@"Failed to map file at URL '%@'! (%@)", url, error);
+
+        return nil;
+    }
+
+    return [self loadFromData:data filter:filter];
+}
+
++ (instancetype) loadFromData:(NSData *)data filter:(MTLoadFilter *)filter
+{
+    if ([data length] < sizeof(UInt32))
+    {
+        NSLog(@"Buffer is too small for Mach-O header!");
+
+        return nil;
+    }
+
+    // This is the only place we look at the byte order or word size of the image.
+    const MTImageDecoder *decoder = MTImageDecoderForImage([data bytes]);
+
+    if (!decoder)
+    {
+        NSLog(@"Mach-O header magic value malformed!");
+
+        return nil;
+    }
+
+    if ([data length] < decoder->headerSize)
+    {
+        NSLog(@"Buffer is too small for Mach-O header!");
+
+        return nil;
+    }
+
+    struct mach_header_64 header;
+    decoder->readHeader([data bytes], &header);
+
+    // This is the cheapest place to reject an image, before anything is allocated.
+    if (filter && ![filter acceptsMachineType:header.cputype subtype:header.cpusubtype])
+        return nil;
+
+    MTMachO *instance = [[self alloc] init];
+
+    if (instance)
+    {
+        instance->_data = data;
+        instance->_decoder = decoder;
+        instance->_header = header;
+        instance->_filter = filter;
+
+        if (![instance parseLoadCommands])
+            return nil;
+    }
+
+    return instance;
+}
+
+- (BOOL) parseLoadCommands
+{
+    const UInt8 *base = (const UInt8 *)[self->_data bytes];
+    const MTImageDecoder *decoder = self->_decoder;
+    MTLoadFilter *filter = self->_filter;
+
+    if (decoder->headerSize + (size_t)self->_header.sizeofcmds > [self->_data length])
+    {
+        NSLog(@"Mach-O load commands extend past end of image!");
+
+        return NO;
+    }
+
+    // Every command is walked and decoded up front, in one call specialized for this image's word size and byte order.
+    MTDecodedLoadCommands decoded;
+
+    if (!decoder->readLoadCommands(base, &self->_header, &decoded))
+        return NO;
+
+    NSMutableArray<MTLoadCommand *> *commands = [[NSMutableArray alloc] initWithCapacity:decoded.count];
+    BOOL result = YES;
+
+    for (UInt32 i = 0; result && i < decoded.count; i++)
+    {
+        const MTDecodedLoadCommand *loadCommand = &decoded.commands[i];
+        NSRange range = NSMakeRange(loadCommand->offset, loadCommand->cmdsize);
+        MTLoadCommand *command;
+
+        // Segments may be needed just for some of their sections.
+        BOOL wanted = !filter || [filter wantsLoadCommand:loadCommand->cmd];
+
+        if (!wanted && loadCommand->cmd == decoder->segmentCommand)
+            wanted = [filter wantsSegmentNamed:loadCommand->segment.segname];
+
+        if (!wanted)
+            continue;
+
+        switch (loadCommand->cmd)
+        {
+            case LC_SEGMENT:
+            case LC_SEGMENT_64: {
+                command = [[MTSegmentInfo alloc] initWithImage:self range:range segment:&loadCommand->segment sections:loadCommand->sections];
+            } break;
+            case LC_LOAD_DYLIB:
+            case LC_LOAD_WEAK_DYLIB:
+            case LC_REEXPORT_DYLIB:
+            case LC_LOAD_UPWARD_DYLIB: {
+                command = [[MTDylibInfo alloc] initWithImage:self type:loadCommand->cmd range:range];
+            } break;
+            case LC_BUILD_VERSION:
+            case LC_VERSION_MIN_MACOSX:
+            case LC_VERSION_MIN_IPHONEOS:
+            case LC_VERSION_MIN_TVOS:
+            case LC_VERSION_MIN_WATCHOS: {
+                command = [[MTBuildVersionInfo alloc] initWithImage:self type:loadCommand->cmd range:range];
+            } break;
+            case LC_LINKER_OPTION: {
+                command = [[MTLinkerOptionInfo alloc] initWithImage:self type:loadCommand->cmd range:range];
+            } break;
+            default: {
+                command = [[MTLoadCommand alloc] initWithImage:self type:loadCommand->cmd range:range];
+            } break;
+        }
+
+        if (command) {
+            [commands addObject:command];
+        } else {
+            result = NO;
+        }
+    }
+
+    MTDecodedLoadCommandsFree(&decoded);
+
+    if (result)
+        self->_loadCommands = [commands copy];
+
+    return result;
+}
+
+#pragma mark Property getters
+
+- (const MTImageDecoder *) decoder
+{
+    return self->_decoder;
+}
+
+- (const struct mach_header_64 *) header
+{
+    return &self->_header;
+}
+
+- (NSData *) imageData
+{
+    return self->_data;
+}
+
+- (MTLoadFilter *) filter
+{
+    return self->_filter;
+}
+
+- (BOOL) is64bit
+{
+    return self->_decoder->is64bit;
+}
+
+- (BOOL) isSwapped
+{
+    return self->_decoder->isSwapped;
+}
+
+- (MTMachOImageType) type
+{
+    return self->_header.filetype;
+}
+
+- (MTMachineType) machineType
+{
+    return self->_header.cputype;
+}
+
+- (MTMachineSubtype) subtype
+{
+    return self->_header.cpusubtype;
+}
+
+- (NSArray<MTLoadCommand *> *) allLoadCommands
+{
+    return self->_loadCommands;
+}
+
+- (NSArray<MTSegmentInfo *> *) segments
+{
+    NSMutableArray<MTSegmentInfo *> *segments = [[NSMutableArray alloc] init];
+
+    for (MTLoadCommand *command in self->_loadCommands)
+    {
+        if ([command isKindOfClass:[MTSegmentInfo class]])
+            [segments addObject:(MTSegmentInfo *)command];
+    }
+
+    return [segments copy];
+}
+
+#pragma mark Loading from other processes
 
 + (NSArray<NSDictionary<NSString *, id> *> *) imageListFromProcess:(pid_t)process
 {
@@ -70,8 +738,8 @@
 }
 
 // Note: We make some assumptions about the types of images that can be in other processes's address space.
-// Specifically, we assume there are only 64-bit images which aren't object files,
-//   core files, or dsym files. Other than that, we should be able to grab everything.
+// Specifically, we assume there are no object files, core files, or dsym files.
+// Other than that, we should be able to grab everything (any word size or byte order).
 + (instancetype) loadFromImageInProcess:(NSDictionary<NSString *, id> *)imageInfo
 {
     if (![[imageInfo objectForKey:@"valid"] boolValue])
@@ -112,8 +780,8 @@
     if (!headerRegion)
         return nil;
 
-    // Make sure we get at least a mach-o image header.
-    if ([headerRegion size] < sizeof(struct mach_header_64))
+    // Make sure we get at least a magic value.
+    if ([headerRegion size] < sizeof(UInt32))
     {
         NSLog(@"Provided memory region too small for image header!");
 
@@ -128,34 +796,38 @@
 
     // This is now in our task's address space
     vm_address_t headerBase = [headerRegion base] + headerOffset;
-    struct mach_header_64 *header = (struct mach_header_64 *)headerBase;
 
     // Make sure we have a valid Mach-O header before doing anything else.
-    // Note: We only support native endian 64-bit images here.
-    // If you have more than that in your address space, you're doing something weird...
-    if (header->magic != MH_MAGIC_64)
+    // We decide how to read the image exactly once here. In practice this should always
+    //   be the native decoder, but there's no reason to refuse anything else.
+    const MTImageDecoder *decoder = MTImageDecoderForImage((const void *)headerBase);
+
+    if (!decoder)
     {
         NSLog(@"Mach-O header magic value malformed!");
 
         return nil;
     }
 
+    if ([headerRegion size] - headerOffset < decoder->headerSize)
+    {
+        NSLog(@"Provided memory region too small for image header!");
+
+        return nil;
+    }
+
+    struct mach_header_64 _header;
+    struct mach_header_64 *header = &_header;
+    decoder->readHeader((const void *)headerBase, header);
+
     NSLog(@"Mach-O image has %u load commands taking up %u bytes. Flags: 0x%08X", header->ncmds, header->sizeofcmds, header->flags);
 
-    NSLog(@"Mach-O is for architecture '%@'", MTMachineTypeToString(header->cputype));
+    NSLog(@"Mach-O is for architecture '%@' (%s bit, %s endian)", MTMachineTypeToString(header->cputype), decoder->is64bit ? "64" : "32", decoder->isSwapped ? "swapped" : "native");
 
     // Check some flags and things to ensure we know what to do with the image we've found.
     BOOL isCached;
     BOOL isPie;
 
-    if (!(header->cputype & CPU_ARCH_ABI64))
-    {
-        // We can't handle 32-bit in process images for now.
-        NSLog(@"Mach-O image CPU_ARCH_ABI64 unset!");
-
-        return nil;
-    }
-
     switch (header->filetype)
     {
         case MH_EXECUTE: {
@@ -215,7 +887,7 @@
     // After checking mach_loader.c in XNU source, it appears the kernel only ensures
     //   there exists some segment mapping the header. I don't know if this is really
     //   enough, to ensure we can process all valid Mach-O files, but oh well...
-    if (sizeof(struct mach_header_64) + header->sizeofcmds > ([headerRegion size] - headerOffset))
+    if (decoder->headerSize + header->sizeofcmds > ([headerRegion size] - headerOffset))
     {
         NSLog(@"Mapped region is too small for Mach-O header and load commands!");
 
@@ -233,6 +905,11 @@
     // Effectively, we reverse the algorithm used by the kernel to load segemnts in
     //   memory. I've read the algorithm used in bsd/mach_loader.c and reverse it here.
 
+    MTDecodedLoadCommands decoded;
+
+    if (!decoder->readLoadCommands((const void *)headerBase, header, &decoded))
+        return nil;
+
     BOOL foundHeaderSegment = NO;
     uint32_t segmentCount = 1;
     int64_t slide = 0;
@@ -248,75 +925,49 @@
             continue;
         }
 
-        size_t commandsEnd = sizeof(struct mach_header_64) + header->sizeofcmds;
-        size_t offset = sizeof(struct mach_header_64);
-        uint32_t ncmds = header->ncmds;
-
-        while (ncmds--)
+        for (UInt32 i = 0; i < decoded.count; i++)
         {
-            if (offset + sizeof(struct load_command) > commandsEnd)
-            {
-                NSLog(@"Found load commands past end of expected section!");
+            const MTDecodedLoadCommand *loadCommand = &decoded.commands[i];
 
-                return nil;
-            }
-
-            struct load_command *loadCommand = (struct load_command *)([headerRegion base] + offset);
-            offset += loadCommand->cmdsize;
-
-            if (offset > commandsEnd || loadCommand->cmdsize < sizeof(struct load_command))
+            // Look for segment commands. Ones of the wrong width were already rejected while decoding.
+            if (loadCommand->cmd != decoder->segmentCommand)
             {
-                NSLog(@"Found command with too small/large size in image!");
+                // Skip non-segment load commands
+                NSLog(@"Found load command: %@", MTMachOLoadCommandName(loadCommand->cmd));
 
-                return nil;
+                continue;
             }
 
-            // Look for segment commands
-            switch (loadCommand->cmd)
-            {
-                case LC_SEGMENT_64: {
-                    if (loadCommand->cmdsize < sizeof(struct segment_command_64))
+            const struct segment_command_64 *segment = &loadCommand->segment;
+
+            if (pass == 0) {
+                if (segment->fileoff == 0 && segment->filesize > 0) {
+                    if (foundHeaderSegment)
                     {
-                        NSLog(@"Found undersized segment command (64 bit) in image!");
+                        NSLog(@"Found two segments mapping image header!");
 
+                        MTDecodedLoadCommandsFree(&decoded);
                         return nil;
                     }
 
-                    struct segment_command_64 *segment = (struct segment_command_64 *)loadCommand;
+                    // Slide is the offset from the expected vmaddr in the target task's address space.
+                    slide = target - segment->vmaddr;
 
-                    if (pass == 0) {
-                        if (segment->fileoff == 0 && segment->filesize > 0) {
-                            if (foundHeaderSegment)
-                            {
-                                NSLog(@"Found two segments mapping image header!");
+                    NSLog(@"Found segment '%.16s' mapping file header!", segment->segname);
+                    NSLog(@"Calculated image slide: 0x%08llX", slide);
 
-                                return nil;
-                            }
+                    foundHeaderSegment = YES;
+                } else if (segment->filesize > 0) {
+                    segmentCount++;
+                }
+            } else { // pass == 1
+                if (segment->filesize > 0 && segment->fileoff != 0)
+                {
+                    vm_address_t slidBase = segment->vmaddr + slide;
 
-                            // Slide is the offset from the expected vmaddr in the target task's address space.
-                            slide = target - segment->vmaddr;
-
-                            NSLog(@"Found segment '%.16s' mapping file header!", segment->segname);
-                            NSLog(@"Calculated image slide: 0x%08llX", slide);
-
-                            foundHeaderSegment = YES;
-                        } else if (segment->filesize > 0) {
-                            segmentCount++;
-                        }
-                    } else { // pass == 1
-                        if (segment->filesize > 0 && segment->fileoff != 0)
-                        {
-                            vm_address_t slidBase = segment->vmaddr + slide;
-
-                            NSLog(@"Found segment '%.16s'", segment->segname);
-                            NSLog(@"Should be mapped at 0x%08llX --> 0x%08lX", segment->vmaddr, slidBase);
-                        }
-                    }
-                } break;
-                // Skip non-segment load commands
-                default:
-                    NSLog(@"Found load command: %@", MTMachOLoadCommandName(loadCommand->cmd));
-                    break;
+                    NSLog(@"Found segment '%.16s'", segment->segname);
+                    NSLog(@"Should be mapped at 0x%08llX --> 0x%08lX", segment->vmaddr, slidBase);
+                }
             }
         }
 
@@ -326,6 +977,7 @@
             {
                 NSLog(@"Didn't find load command mapping header segment in image!");
 
+                MTDecodedLoadCommandsFree(&decoded);
                 return nil;
             }
 
@@ -333,6 +985,7 @@
         }
     }
 
+    MTDecodedLoadCommandsFree(&decoded);
     return nil;
 }
 
@@ -0,0 +1,56 @@
+// This is a private header. It is not exported from the MTool framework.
+#pragma once
+
+#import <MTool/MTMachO.h>
+#import "MTImageDecoder.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface MTMachO (Private)
+
+// The decoder chosen for this image when it was loaded.
+@property (nonatomic, readonly) const MTImageDecoder *decoder;
+
+// The image header, decoded to 64 bit, host endian.
+@property (nonatomic, readonly) const struct mach_header_64 *header;
+
+// Backing storage for this image. Offsets in load commands are relative to the start of this.
+@property (nonatomic, readonly) NSData *imageData;
+
+@end
+
+@interface MTLoadCommand (Private)
+
+// Commands only keep the location of their raw data, it is not copied until requested.
+- (instancetype) initWithImage:(MTMachO *)image type:(UInt32)type range:(NSRange)range;
+
+// The location of this command in the image data.
+@property (nonatomic, readonly) NSRange range;
+
+// Pointer to the raw command in the image data.
+@property (nonatomic, readonly) const UInt8 *rawCommand;
+
+@end
+
+// Read a ULEB128 value at `*pointer`, advancing it past the value. Returns NO if the value runs past `end` or doesn't fit in 64 bits.
+static inline BOOL MTReadULEB128(const UInt8 *_Nonnull *_Nonnull pointer, const UInt8 *end, UInt64 *value)
+{
+    const UInt8 *p = (*pointer);
+    UInt64 result = 0;
+    UInt32 shift = 0;
+
+    do {
+        if (p >= end || shift >= 64)
+            return NO;
+
+        result |= ((UInt64)(*p & 0x7F) << shift);
+        shift += 7;
+    } while (*p++ & 0x80);
+
+    (*pointer) = p;
+    (*value) = result;
+
+    return YES;
+}
+
+NS_ASSUME_NONNULL_END
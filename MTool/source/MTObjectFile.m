@@ -0,0 +1,472 @@
+#import <MTool/MTool.h>
+#import <MTool/MTMachO.h>
+
+#import <mach-o/loader.h>
+#import <mach-o/reloc.h>
+#import <mach-o/x86_64/reloc.h>
+#import <mach-o/arm64/reloc.h>
+
+#import "MTMachOPrivate.h"
+
+// Below this many relocations in an image, handing sections to other threads costs more than it saves.
+#define kMTObjectFileParallelRelocations    4096
+
+// Bytes of column storage per relocation (addresses, symbol numbers, values, types, lengths, flags)
+#define kMTRelocationColumnSize             ((3 * sizeof(UInt32)) + (2 * sizeof(UInt8)) + sizeof(MTRelocationFlags))
+
+// How relocations are paired up. This depends only on the architecture.
+typedef NS_ENUM(UInt32, MTRelocationPairing) {
+    // A *_RELOC_PAIR entry (type 1 for every classic architecture) belongs to the entry before it.
+    kMTRelocationPairingClassic,
+
+    // X86_64_RELOC_SUBTRACTOR is followed by the X86_64_RELOC_UNSIGNED it applies to.
+    kMTRelocationPairingX86_64,
+
+    // ARM64_RELOC_SUBTRACTOR and ARM64_RELOC_ADDEND are followed by the relocation they apply to.
+    kMTRelocationPairingARM64
+};
+
+// The columns for one section. These all point into a buffer shared by the whole image.
+typedef struct {
+    UInt32 *addresses;
+    UInt32 *symbolNumbers;
+    UInt32 *values;
+    UInt8 *types;
+    UInt8 *lengths;
+    MTRelocationFlags *flags;
+} MTRelocationColumns;
+
+static void MTRelocationDecode(const UInt8 *raw, NSUInteger count, const MTImageDecoder *decoder, MTRelocationPairing pairing, const MTRelocationColumns *columns)
+{
+    // Only the classic (32 bit) architectures use scattered relocations.
+    // On x86_64 and arm64, the high bit of r_address is just part of the address.
+    BOOL mayBeScattered = (pairing == kMTRelocationPairingClassic);
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        UInt32 word0 = decoder->read32(raw + (i * sizeof(struct relocation_info)));
+        UInt32 word1 = decoder->read32(raw + (i * sizeof(struct relocation_info)) + sizeof(UInt32));
+
+        if (mayBeScattered && (word0 & R_SCATTERED)) {
+            // scattered_relocation_info is declared so that its fields land in the same bits regardless of byte order.
+            columns->addresses[i] = word0 & 0x00FFFFFF;
+            columns->types[i] = (word0 >> 24) & 0xF;
+            columns->lengths[i] = (word0 >> 28) & 0x3;
+            columns->flags[i] = kMTRelocationFlagScattered | (((word0 >> 30) & 1) ? kMTRelocationFlagPCRelative : 0);
+
+            columns->symbolNumbers[i] = 0;
+            columns->values[i] = word1;
+        } else if (decoder->isSwapped) {
+            // relocation_info isn't, so a big endian image packs its bit fields from the top. (Hosts are always little endian.)
+            columns->addresses[i] = word0;
+            columns->symbolNumbers[i] = word1 >> 8;
+            columns->lengths[i] = (word1 >> 5) & 0x3;
+            columns->types[i] = word1 & 0xF;
+            columns->flags[i] = (((word1 >> 7) & 1) ? kMTRelocationFlagPCRelative : 0) | (((word1 >> 4) & 1) ? kMTRelocationFlagExtern : 0);
+
+            columns->values[i] = 0;
+        } else {
+            columns->addresses[i] = word0;
+            columns->symbolNumbers[i] = word1 & 0x00FFFFFF;
+            columns->lengths[i] = (word1 >> 25) & 0x3;
+            columns->types[i] = (word1 >> 28) & 0xF;
+            columns->flags[i] = (((word1 >> 24) & 1) ? kMTRelocationFlagPCRelative : 0) | (((word1 >> 27) & 1) ? kMTRelocationFlagExtern : 0);
+
+            columns->values[i] = 0;
+        }
+    }
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        UInt8 type = columns->types[i];
+
+        switch (pairing)
+        {
+            case kMTRelocationPairingClassic: {
+                if (type == GENERIC_RELOC_PAIR && i > 0)
+                {
+                    columns->flags[i - 1] |= kMTRelocationFlagPairFirst;
+                    columns->flags[i] |= kMTRelocationFlagPairSecond;
+                }
+            } break;
+            case kMTRelocationPairingX86_64:
+            case kMTRelocationPairingARM64: {
+                BOOL first = (pairing == kMTRelocationPairingX86_64) ? (type == X86_64_RELOC_SUBTRACTOR) : (type == ARM64_RELOC_SUBTRACTOR || type == ARM64_RELOC_ADDEND);
+
+                // An entry can't start a pair if it already ends one.
+                if (first && i + 1 < count && !(columns->flags[i] & kMTRelocationFlagPairSecond))
+                {
+                    columns->flags[i] |= kMTRelocationFlagPairFirst;
+                    columns->flags[i + 1] |= kMTRelocationFlagPairSecond;
+                }
+            } break;
+        }
+    }
+}
+
+#pragma mark - MTRelocationTable
+
+@interface MTRelocationTable (Private)
+
+- (instancetype) initWithSection:(MTSectionInfo *)section storage:(NSData *)storage count:(NSUInteger)count columns:(const MTRelocationColumns *)columns;
+
+@end
+
+@implementation MTRelocationTable
+{
+    // Shared by every table from the same image. This just keeps it alive.
+    NSData *_storage;
+
+    MTRelocationColumns _columns;
+}
+
+@synthesize section = _section;
+@synthesize count = _count;
+
+@dynamic addresses;
+@dynamic symbolNumbers;
+@dynamic values;
+@dynamic types;
+@dynamic lengths;
+@dynamic flags;
+
+- (instancetype) initWithSection:(MTSectionInfo *)section storage:(NSData *)storage count:(NSUInteger)count columns:(const MTRelocationColumns *)columns
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->_section = section;
+        self->_storage = storage;
+        self->_count = count;
+        self->_columns = (*columns);
+    }
+
+    return self;
+}
+
+- (const UInt32 *) addresses
+{
+    return self->_columns.addresses;
+}
+
+- (const UInt32 *) symbolNumbers
+{
+    return self->_columns.symbolNumbers;
+}
+
+- (const UInt32 *) values
+{
+    return self->_columns.values;
+}
+
+- (const UInt8 *) types
+{
+    return self->_columns.types;
+}
+
+- (const UInt8 *) lengths
+{
+    return self->_columns.lengths;
+}
+
+- (const MTRelocationFlags *) flags
+{
+    return self->_columns.flags;
+}
+
+@end
+
+#pragma mark - MTOptimizationHintTable
+
+@interface MTOptimizationHintTable (Private)
+
+- (instancetype) initWithData:(const UInt8 *)data size:(NSUInteger)size;
+
+@end
+
+@implementation MTOptimizationHintTable
+{
+    // Arguments first (for alignment), then kinds, first arguments and argument counts.
+    NSMutableData *_storage;
+}
+
+@synthesize count = _count;
+@synthesize totalArgumentCount = _totalArgumentCount;
+
+@dynamic kinds;
+@dynamic firstArguments;
+@dynamic argumentCounts;
+@dynamic arguments;
+
+// Walk the hints, filling in the columns if `storage` is set. Returns NO if the data is malformed.
++ (BOOL) scanData:(const UInt8 *)data size:(NSUInteger)size count:(NSUInteger *)count argumentCount:(NSUInteger *)argumentCount into:(MTOptimizationHintTable *)table
+{
+    const UInt8 *p = data;
+    const UInt8 *end = data + size;
+    NSUInteger hints = 0;
+    NSUInteger arguments = 0;
+
+    while (p < end)
+    {
+        UInt64 kind;
+        UInt64 argCount;
+
+        if (!MTReadULEB128(&p, end, &kind))
+            return NO;
+
+        // The list is padded out to pointer alignment with zeroes.
+        if (!kind)
+            break;
+
+        if (!MTReadULEB128(&p, end, &argCount) || argCount > (UInt64)(end - p))
+            return NO;
+
+        if (table)
+        {
+            UInt64 *argumentColumn = [table->_storage mutableBytes];
+            UInt32 *kinds = (UInt32 *)(argumentColumn + table->_totalArgumentCount);
+
+            kinds[hints] = (UInt32)kind;
+            kinds[table->_count + hints] = (UInt32)arguments;
+            kinds[(2 * table->_count) + hints] = (UInt32)argCount;
+
+            for (UInt64 i = 0; i < argCount; i++)
+            {
+                if (!MTReadULEB128(&p, end, &argumentColumn[arguments + i]))
+                    return NO;
+            }
+        } else {
+            for (UInt64 i = 0; i < argCount; i++)
+            {
+                UInt64 argument;
+
+                if (!MTReadULEB128(&p, end, &argument))
+                    return NO;
+            }
+        }
+
+        hints++;
+        arguments += argCount;
+    }
+
+    (*count) = hints;
+    (*argumentCount) = arguments;
+
+    return YES;
+}
+
+- (instancetype) initWithData:(const UInt8 *)data size:(NSUInteger)size
+{
+    self = [super init];
+
+    if (self)
+    {
+        // Count first so everything fits in one allocation.
+        if (![MTOptimizationHintTable scanData:data size:size count:&self->_count argumentCount:&self->_totalArgumentCount into:nil])
+            return nil;
+
+        self->_storage = [[NSMutableData alloc] initWithLength:(self->_totalArgumentCount * sizeof(UInt64)) + (3 * self->_count * sizeof(UInt32))];
+
+        NSUInteger count;
+        NSUInteger argumentCount;
+
+        if (![MTOptimizationHintTable scanData:data size:size count:&count argumentCount:&argumentCount into:self])
+            return nil;
+    }
+
+    return self;
+}
+
+- (const UInt64 *) arguments
+{
+    return [self->_storage bytes];
+}
+
+- (const UInt32 *) kinds
+{
+    return (const UInt32 *)([self arguments] + self->_totalArgumentCount);
+}
+
+- (const UInt32 *) firstArguments
+{
+    return [self kinds] + self->_count;
+}
+
+- (const UInt32 *) argumentCounts
+{
+    return [self kinds] + (2 * self->_count);
+}
+
+@end
+
+#pragma mark - MTObjectFile
+
+@implementation MTObjectFile
+
+@dynamic sections;
+@dynamic linkerOptions;
+
+- (NSArray<MTSectionInfo *> *) sections
+{
+    NSMutableArray<MTSectionInfo *> *sections = [[NSMutableArray alloc] init];
+
+    // Object files normally have a single unnamed segment, but nothing requires that.
+    for (MTSegmentInfo *segment in [self segments])
+        [sections addObjectsFromArray:[segment sections]];
+
+    return [sections copy];
+}
+
+- (NSArray<MTLinkerOptionInfo *> *) linkerOptions
+{
+    NSMutableArray<MTLinkerOptionInfo *> *options = [[NSMutableArray alloc] init];
+
+    for (MTLoadCommand *command in [self allLoadCommands])
+    {
+        if ([command isKindOfClass:[MTLinkerOptionInfo class]])
+            [options addObject:(MTLinkerOptionInfo *)command];
+    }
+
+    return [options copy];
+}
+
+- (NSArray<MTRelocationTable *> *) decodeRelocations
+{
+    NSArray<MTSectionInfo *> *sections = [self sections];
+    NSUInteger sectionCount = [sections count];
+    NSData *data = [self imageData];
+
+    // Where each section's entries start in the shared columns. There is one extra for the total.
+    NSUInteger *starts = calloc(sectionCount + 1, sizeof(NSUInteger));
+
+    if (!starts)
+        return nil;
+
+    for (NSUInteger i = 0; i < sectionCount; i++)
+    {
+        MTSectionInfo *section = [sections objectAtIndex:i];
+        UInt64 end = [section relocationOffset] + ((UInt64)[section relocationCount] * sizeof(struct relocation_info));
+
+        if ([section relocationCount] && end > [data length])
+        {
+            NSLog(@"Relocations for section '%@,%@' extend past end of image!", [section segmentName], [section name]);
+
+            free(starts);
+            return nil;
+        }
+
+        starts[i + 1] = starts[i] + [section relocationCount];
+    }
+
+    NSUInteger total = starts[sectionCount];
+    NSMutableData *storage = [[NSMutableData alloc] initWithLength:total * kMTRelocationColumnSize];
+
+    MTRelocationColumns columns;
+    columns.addresses = [storage mutableBytes];
+    columns.symbolNumbers = columns.addresses + total;
+    columns.values = columns.symbolNumbers + total;
+    columns.types = (UInt8 *)(columns.values + total);
+    columns.lengths = columns.types + total;
+    columns.flags = (MTRelocationFlags *)(columns.lengths + total);
+
+    MTRelocationPairing pairing;
+
+    switch ([self machineType])
+    {
+        case kMTMachineTypeX86_64:      pairing = kMTRelocationPairingX86_64;   break;
+        case kMTMachineTypeAArch64:
+        case kMTMachineTypeARM64_32:    pairing = kMTRelocationPairingARM64;    break;
+        default:                        pairing = kMTRelocationPairingClassic;  break;
+    }
+
+    const MTImageDecoder *decoder = [self decoder];
+    const UInt8 *base = [data bytes];
+
+    // Sections write to disjoint parts of the columns, so they don't need to coordinate.
+    void (^decodeSection)(size_t) = ^(size_t i) {
+        MTSectionInfo *section = [sections objectAtIndex:i];
+        NSUInteger start = starts[i];
+
+        MTRelocationColumns sectionColumns = {
+            .addresses = columns.addresses + start,
+            .symbolNumbers = columns.symbolNumbers + start,
+            .values = columns.values + start,
+            .types = columns.types + start,
+            .lengths = columns.lengths + start,
+            .flags = columns.flags + start
+        };
+
+        MTRelocationDecode(base + [section relocationOffset], [section relocationCount], decoder, pairing, &sectionColumns);
+    };
+
+    if (total >= kMTObjectFileParallelRelocations && sectionCount > 1) {
+        dispatch_apply(sectionCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), decodeSection);
+    } else {
+        for (NSUInteger i = 0; i < sectionCount; i++)
+            decodeSection(i);
+    }
+
+    NSMutableArray<MTRelocationTable *> *tables = [[NSMutableArray alloc] initWithCapacity:sectionCount];
+
+    for (NSUInteger i = 0; i < sectionCount; i++)
+    {
+        NSUInteger start = starts[i];
+
+        MTRelocationColumns sectionColumns = {
+            .addresses = columns.addresses + start,
+            .symbolNumbers = columns.symbolNumbers + start,
+            .values = columns.values + start,
+            .types = columns.types + start,
+            .lengths = columns.lengths + start,
+            .flags = columns.flags + start
+        };
+
+        [tables addObject:[[MTRelocationTable alloc] initWithSection:[sections objectAtIndex:i] storage:storage count:(starts[i + 1] - start) columns:&sectionColumns]];
+    }
+
+    free(starts);
+
+    return [tables copy];
+}
+
+- (MTOptimizationHintTable *) decodeOptimizationHints
+{
+    const MTImageDecoder *decoder = [self decoder];
+    NSData *data = [self imageData];
+
+    for (MTLoadCommand *command in [self allLoadCommands])
+    {
+        if ([command type] != LC_LINKER_OPTIMIZATION_HINT)
+            continue;
+
+        if ([command range].length < sizeof(struct linkedit_data_command))
+        {
+            NSLog(@"Found undersized optimization hint command in image!");
+
+            return nil;
+        }
+
+        const UInt8 *raw = [command rawCommand];
+        UInt32 offset = decoder->read32(raw + offsetof(struct linkedit_data_command, dataoff));
+        UInt32 size = decoder->read32(raw + offsetof(struct linkedit_data_command, datasize));
+
+        if ((UInt64)offset + size > [data length])
+        {
+            NSLog(@"Optimization hints extend past end of image!");
+
+            return nil;
+        }
+
+        MTOptimizationHintTable *table = [[MTOptimizationHintTable alloc] initWithData:((const UInt8 *)[data bytes] + offset) size:size];
+
+        if (!table)
+            NSLog(@"Found malformed optimization hints in image!");
+
+        return table;
+    }
+
+    return nil;
+}
+
+@end
@@ -0,0 +1,636 @@
+#import <MTool/MTool.h>
+#import <MTool/MTPageFootprint.h>
+
+#import <mach-o/loader.h>
+#import <mach-o/fixup-chains.h>
+
+#import "MTMachOPrivate.h"
+
+// Older SDKs don't have this. It marks segments dyld makes read only once fixups are done.
+#ifndef SG_READ_ONLY
+#define SG_READ_ONLY 0x10
+#endif
+
+// Threaded binds (pre chained fixup arm64e) give the distance to the next pointer in these bits, in 8 byte units.
+#define kMTThreadedNextShift    51
+#define kMTThreadedNextMask     0x7FF
+
+NSString *MTSegmentKindName(MTSegmentKind kind)
+{
+    switch (kind)
+    {
+        case kMTSegmentKindReadOnly:    return @"read only";
+        case kMTSegmentKindData:        return @"data";
+        case kMTSegmentKindDataConst:   return @"data const";
+        case kMTSegmentKindAuth:        return @"auth";
+        case kMTSegmentKindAuthConst:   return @"auth const";
+        case kMTSegmentKindLinkedit:    return @"linkedit";
+    }
+
+    return @"unknown";
+}
+
+static MTSegmentKind MTSegmentKindForSegment(MTSegmentInfo *segment)
+{
+    NSString *name = [segment name];
+
+    if ([name isEqualToString:@"__DATA_CONST"])
+        return kMTSegmentKindDataConst;
+
+    if ([name isEqualToString:@"__AUTH_CONST"])
+        return kMTSegmentKindAuthConst;
+
+    if ([name isEqualToString:@"__AUTH"])
+        return kMTSegmentKindAuth;
+
+    if ([name isEqualToString:@SEG_LINKEDIT])
+        return kMTSegmentKindLinkedit;
+
+    if ([segment flags] & SG_READ_ONLY)
+        return kMTSegmentKindDataConst;
+
+    return ([segment initialProtection] & VM_PROT_WRITE) ? kMTSegmentKindData : kMTSegmentKindReadOnly;
+}
+
+// A segment being measured. Dirty pages are tracked in a bitmap, one bit per page.
+typedef struct {
+    UInt64 vmAddress;
+    UInt64 vmSize;
+    UInt64 fileOffset;
+    UInt64 fileSize;
+
+    NSUInteger pageCount;
+    UInt8 *dirty;
+} MTFootprintSegment;
+
+typedef struct {
+    MTFootprintSegment *segments;
+    NSUInteger segmentCount;
+
+    UInt64 pageSize;
+    UInt64 pointerSize;
+
+    const MTImageDecoder *decoder;
+    const UInt8 *imageData;
+    UInt64 imageSize;
+} MTFootprintContext;
+
+// Mark every page overlapping [offset, offset + size) in a segment. Anything outside the segment is ignored.
+static void MTFootprintMark(MTFootprintContext *context, UInt64 segmentIndex, UInt64 offset, UInt64 size)
+{
+    if (segmentIndex >= context->segmentCount || !size)
+        return;
+
+    MTFootprintSegment *segment = &context->segments[segmentIndex];
+
+    if (offset >= segment->vmSize)
+        return;
+
+    UInt64 end = (size > segment->vmSize - offset) ? segment->vmSize : offset + size;
+
+    // Segments start on a page boundary, so offsets convert straight to pages.
+    for (UInt64 page = offset / context->pageSize; page <= (end - 1) / context->pageSize; page++)
+        segment->dirty[page / 8] |= (1 << (page % 8));
+}
+
+// Mark `count` pointers, `stride` bytes apart.
+static void MTFootprintMarkRun(MTFootprintContext *context, UInt64 segmentIndex, UInt64 offset, UInt64 count, UInt64 stride)
+{
+    if (!count || segmentIndex >= context->segmentCount)
+        return;
+
+    UInt64 vmSize = context->segments[segmentIndex].vmSize;
+
+    // Nothing past the end of the segment matters, and this keeps the multiply below from overflowing.
+    if (stride && count > (vmSize / stride) + 1)
+        count = (vmSize / stride) + 1;
+
+    // If no page can be skipped, the run touches every page it spans.
+    if (stride <= context->pageSize)
+    {
+        MTFootprintMark(context, segmentIndex, offset, ((count - 1) * stride) + context->pointerSize);
+
+        return;
+    }
+
+    for (UInt64 i = 0; i < count; i++)
+        MTFootprintMark(context, segmentIndex, offset + (i * stride), context->pointerSize);
+}
+
+#pragma mark - Chained fixups
+
+static UInt16 MTFootprintRead16(const MTImageDecoder *decoder, const UInt8 *raw)
+{
+    UInt16 value;
+    memcpy(&value, raw, sizeof(UInt16));
+
+    return decoder->isSwapped ? OSSwapInt16(value) : value;
+}
+
+// Every chain starts on a page and stays on it, so a page has fixups exactly when it has a chain start.
+// The chains themselves never need to be walked.
+static BOOL MTFootprintApplyChainedFixups(MTFootprintContext *context, const UInt8 *data, UInt64 size)
+{
+    const MTImageDecoder *decoder = context->decoder;
+
+    if (size < sizeof(struct dyld_chained_fixups_header))
+        return NO;
+
+    UInt32 startsOffset = decoder->read32(data + offsetof(struct dyld_chained_fixups_header, starts_offset));
+
+    if ((UInt64)startsOffset + sizeof(UInt32) > size)
+        return NO;
+
+    const UInt8 *starts = data + startsOffset;
+    UInt32 segmentCount = decoder->read32(starts + offsetof(struct dyld_chained_starts_in_image, seg_count));
+
+    if ((UInt64)startsOffset + sizeof(UInt32) + ((UInt64)segmentCount * sizeof(UInt32)) > size)
+        return NO;
+
+    for (UInt32 i = 0; i < segmentCount; i++)
+    {
+        UInt32 infoOffset = decoder->read32(starts + offsetof(struct dyld_chained_starts_in_image, seg_info_offset) + (i * sizeof(UInt32)));
+
+        // Segments without fixups have no info.
+        if (!infoOffset)
+            continue;
+
+        UInt64 infoStart = (UInt64)startsOffset + infoOffset;
+
+        if (infoStart + offsetof(struct dyld_chained_starts_in_segment, page_start) > size)
+            return NO;
+
+        const UInt8 *info = data + infoStart;
+        UInt16 pageSize = MTFootprintRead16(decoder, info + offsetof(struct dyld_chained_starts_in_segment, page_size));
+        UInt16 pageCount = MTFootprintRead16(decoder, info + offsetof(struct dyld_chained_starts_in_segment, page_count));
+
+        if (infoStart + offsetof(struct dyld_chained_starts_in_segment, page_start) + (pageCount * sizeof(UInt16)) > size)
+            return NO;
+
+        for (UInt16 page = 0; page < pageCount; page++)
+        {
+            UInt16 start = MTFootprintRead16(decoder, info + offsetof(struct dyld_chained_starts_in_segment, page_start) + (page * sizeof(UInt16)));
+
+            if (start == DYLD_CHAINED_PTR_START_NONE)
+                continue;
+
+            // Chained fixup pages may be smaller than real pages (ex. 4K chains in an arm64 image), so this can mark a page more than once.
+            MTFootprintMark(context, i, (UInt64)page * pageSize, pageSize);
+        }
+    }
+
+    return YES;
+}
+
+#pragma mark - LC_DYLD_INFO
+
+static BOOL MTFootprintApplyRebaseOpcodes(MTFootprintContext *context, const UInt8 *p, const UInt8 *end)
+{
+    UInt64 pointerSize = context->pointerSize;
+    UInt64 segment = 0;
+    UInt64 offset = 0;
+
+    while (p < end)
+    {
+        UInt8 opcode = *p & REBASE_OPCODE_MASK;
+        UInt8 immediate = *p & REBASE_IMMEDIATE_MASK;
+        UInt64 count;
+        UInt64 skip;
+
+        p++;
+
+        switch (opcode)
+        {
+            case REBASE_OPCODE_DONE:
+                return YES;
+            case REBASE_OPCODE_SET_TYPE_IMM:
+                break;
+            case REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB: {
+                segment = immediate;
+
+                if (!MTReadULEB128(&p, end, &offset))
+                    return NO;
+            } break;
+            case REBASE_OPCODE_ADD_ADDR_ULEB: {
+                if (!MTReadULEB128(&p, end, &skip))
+                    return NO;
+
+                offset += skip;
+            } break;
+            case REBASE_OPCODE_ADD_ADDR_IMM_SCALED: {
+                offset += immediate * pointerSize;
+            } break;
+            case REBASE_OPCODE_DO_REBASE_IMM_TIMES: {
+                MTFootprintMarkRun(context, segment, offset, immediate, pointerSize);
+                offset += immediate * pointerSize;
+            } break;
+            case REBASE_OPCODE_DO_REBASE_ULEB_TIMES: {
+                if (!MTReadULEB128(&p, end, &count))
+                    return NO;
+
+                MTFootprintMarkRun(context, segment, offset, count, pointerSize);
+                offset += count * pointerSize;
+            } break;
+            case REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB: {
+                if (!MTReadULEB128(&p, end, &skip))
+                    return NO;
+
+                MTFootprintMark(context, segment, offset, pointerSize);
+                offset += skip + pointerSize;
+            } break;
+            case REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB: {
+                if (!MTReadULEB128(&p, end, &count) || !MTReadULEB128(&p, end, &skip))
+                    return NO;
+
+                MTFootprintMarkRun(context, segment, offset, count, skip + pointerSize);
+                offset += count * (skip + pointerSize);
+            } break;
+            default:
+                return NO;
+        }
+    }
+
+    return YES;
+}
+
+// Threaded binds are a chain of pointers in the segment data, each holding the distance to the next.
+static BOOL MTFootprintApplyThreadedChain(MTFootprintContext *context, UInt64 segmentIndex, UInt64 offset)
+{
+    if (segmentIndex >= context->segmentCount)
+        return NO;
+
+    const MTFootprintSegment *segment = &context->segments[segmentIndex];
+
+    while (offset + sizeof(UInt64) <= segment->fileSize && segment->fileOffset + offset + sizeof(UInt64) <= context->imageSize)
+    {
+        UInt64 value = context->decoder->read64(context->imageData + segment->fileOffset + offset);
+        UInt64 next = (value >> kMTThreadedNextShift) & kMTThreadedNextMask;
+
+        MTFootprintMark(context, segmentIndex, offset, sizeof(UInt64));
+
+        if (!next)
+            return YES;
+
+        offset += next * sizeof(UInt64);
+    }
+
+    return NO;
+}
+
+static BOOL MTFootprintApplyBindOpcodes(MTFootprintContext *context, const UInt8 *p, const UInt8 *end)
+{
+    UInt64 pointerSize = context->pointerSize;
+    UInt64 segment = 0;
+    UInt64 offset = 0;
+
+    while (p < end)
+    {
+        UInt8 opcode = *p & BIND_OPCODE_MASK;
+        UInt8 immediate = *p & BIND_IMMEDIATE_MASK;
+        UInt64 count;
+        UInt64 skip;
+
+        p++;
+
+        switch (opcode)
+        {
+            case BIND_OPCODE_DONE:
+                return YES;
+            case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
+            case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
+            case BIND_OPCODE_SET_TYPE_IMM:
+                break;
+            case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+            case BIND_OPCODE_SET_ADDEND_SLEB: {
+                // Only the length matters here, and that's the same for SLEB.
+                if (!MTReadULEB128(&p, end, &skip))
+                    return NO;
+            } break;
+            case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM: {
+                size_t length = strnlen((const char *)p, end - p);
+
+                if (p + length >= end)
+                    return NO;
+
+                p += length + 1;
+            } break;
+            case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB: {
+                segment = immediate;
+
+                if (!MTReadULEB128(&p, end, &offset))
+                    return NO;
+            } break;
+            case BIND_OPCODE_ADD_ADDR_ULEB: {
+                if (!MTReadULEB128(&p, end, &skip))
+                    return NO;
+
+                offset += skip;
+            } break;
+            case BIND_OPCODE_DO_BIND: {
+                MTFootprintMark(context, segment, offset, pointerSize);
+                offset += pointerSize;
+            } break;
+            case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB: {
+                if (!MTReadULEB128(&p, end, &skip))
+                    return NO;
+
+                MTFootprintMark(context, segment, offset, pointerSize);
+                offset += skip + pointerSize;
+            } break;
+            case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED: {
+                MTFootprintMark(context, segment, offset, pointerSize);
+                offset += (immediate * pointerSize) + pointerSize;
+            } break;
+            case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB: {
+                if (!MTReadULEB128(&p, end, &count) || !MTReadULEB128(&p, end, &skip))
+                    return NO;
+
+                MTFootprintMarkRun(context, segment, offset, count, skip + pointerSize);
+                offset += count * (skip + pointerSize);
+            } break;
+            case BIND_OPCODE_THREADED: {
+                if (immediate == BIND_SUBOPCODE_THREADED_SET_BIND_ORDINAL_TABLE_SIZE_ULEB) {
+                    if (!MTReadULEB128(&p, end, &skip))
+                        return NO;
+                } else if (immediate == BIND_SUBOPCODE_THREADED_APPLY) {
+                    if (!MTFootprintApplyThreadedChain(context, segment, offset))
+                        return NO;
+                } else {
+                    return NO;
+                }
+            } break;
+            default:
+                return NO;
+        }
+    }
+
+    return YES;
+}
+
+#pragma mark - MTSegmentFootprint
+
+@interface MTSegmentFootprint (Private)
+
+- (instancetype) initWithSegment:(MTSegmentInfo *)segment pageCount:(NSUInteger)pageCount dirtyPageCount:(NSUInteger)dirtyPageCount zeroFillPageCount:(NSUInteger)zeroFillPageCount;
+
+@end
+
+@implementation MTSegmentFootprint
+
+@synthesize name = _name;
+@synthesize kind = _kind;
+@synthesize vmAddress = _vmAddress;
+
+@synthesize pageCount = _pageCount;
+@synthesize dirtyPageCount = _dirtyPageCount;
+@synthesize zeroFillPageCount = _zeroFillPageCount;
+
+- (instancetype) initWithSegment:(MTSegmentInfo *)segment pageCount:(NSUInteger)pageCount dirtyPageCount:(NSUInteger)dirtyPageCount zeroFillPageCount:(NSUInteger)zeroFillPageCount
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->_name = [segment name];
+        self->_kind = MTSegmentKindForSegment(segment);
+        self->_vmAddress = [segment vmAddress];
+
+        self->_pageCount = pageCount;
+        self->_dirtyPageCount = dirtyPageCount;
+        self->_zeroFillPageCount = zeroFillPageCount;
+    }
+
+    return self;
+}
+
+@end
+
+#pragma mark - MTImageFootprint
+
+@implementation MTImageFootprint
+
+@synthesize pageSize = _pageSize;
+@synthesize fixupSource = _fixupSource;
+@synthesize segments = _segments;
+
+@dynamic dirtyPageCount;
+@dynamic zeroFillPageCount;
+@dynamic dirtyBytes;
+@dynamic zeroFillBytes;
+
++ (MTLoadFilter *) loadFilter
+{
+    MTLoadFilter *filter = [[MTLoadFilter alloc] init];
+
+    [filter addLoadCommand:LC_SEGMENT];
+    [filter addLoadCommand:LC_SEGMENT_64];
+    [filter addLoadCommand:LC_DYLD_INFO];
+    [filter addLoadCommand:LC_DYLD_INFO_ONLY];
+    [filter addLoadCommand:LC_DYLD_CHAINED_FIXUPS];
+
+    return filter;
+}
+
+// Find the fixups in `image` and mark the pages they touch. Returns NO if they're malformed.
+- (BOOL) applyFixupsForImage:(MTMachO *)image context:(MTFootprintContext *)context
+{
+    const MTImageDecoder *decoder = [image decoder];
+
+    for (MTLoadCommand *command in [image allLoadCommands])
+    {
+        const UInt8 *raw = [command rawCommand];
+
+        switch ([command type])
+        {
+            case LC_DYLD_CHAINED_FIXUPS: {
+                if ([command range].length < sizeof(struct linkedit_data_command))
+                    return NO;
+
+                UInt32 offset = decoder->read32(raw + offsetof(struct linkedit_data_command, dataoff));
+                UInt32 size = decoder->read32(raw + offsetof(struct linkedit_data_command, datasize));
+
+                if ((UInt64)offset + size > context->imageSize)
+                    return NO;
+
+                self->_fixupSource = kMTFixupSourceChainedFixups;
+
+                if (!MTFootprintApplyChainedFixups(context, context->imageData + offset, size))
+                    return NO;
+            } break;
+            case LC_DYLD_INFO:
+            case LC_DYLD_INFO_ONLY: {
+                if ([command range].length < sizeof(struct dyld_info_command))
+                    return NO;
+
+                UInt32 rebaseOffset = decoder->read32(raw + offsetof(struct dyld_info_command, rebase_off));
+                UInt32 rebaseSize = decoder->read32(raw + offsetof(struct dyld_info_command, rebase_size));
+                UInt32 bindOffset = decoder->read32(raw + offsetof(struct dyld_info_command, bind_off));
+                UInt32 bindSize = decoder->read32(raw + offsetof(struct dyld_info_command, bind_size));
+                UInt32 weakBindOffset = decoder->read32(raw + offsetof(struct dyld_info_command, weak_bind_off));
+                UInt32 weakBindSize = decoder->read32(raw + offsetof(struct dyld_info_command, weak_bind_size));
+
+                if ((UInt64)rebaseOffset + rebaseSize > context->imageSize || (UInt64)bindOffset + bindSize > context->imageSize || (UInt64)weakBindOffset + weakBindSize > context->imageSize)
+                    return NO;
+
+                self->_fixupSource = kMTFixupSourceDyldInfo;
+
+                // Lazy binds are left out. Lazy pointers are rebased at load anyway, so their pages are already counted.
+                if (!MTFootprintApplyRebaseOpcodes(context, context->imageData + rebaseOffset, context->imageData + rebaseOffset + rebaseSize) ||
+                    !MTFootprintApplyBindOpcodes(context, context->imageData + bindOffset, context->imageData + bindOffset + bindSize) ||
+                    !MTFootprintApplyBindOpcodes(context, context->imageData + weakBindOffset, context->imageData + weakBindOffset + weakBindSize))
+                {
+                    return NO;
+                }
+            } break;
+        }
+    }
+
+    return YES;
+}
+
++ (instancetype) footprintForImage:(MTMachO *)image
+{
+    MTImageFootprint *footprint = [[MTImageFootprint alloc] init];
+
+    if (!footprint)
+        return nil;
+
+    NSArray<MTSegmentInfo *> *segments = [image segments];
+    NSUInteger segmentCount = [segments count];
+    UInt64 pageSize = ([image machineType] == kMTMachineTypeAArch64 || [image machineType] == kMTMachineTypeARM64_32) ? 0x4000 : 0x1000;
+
+    MTFootprintSegment *measured = calloc(segmentCount ? segmentCount : 1, sizeof(MTFootprintSegment));
+    NSUInteger bitmapSize = 0;
+
+    if (!measured)
+        return nil;
+
+    for (NSUInteger i = 0; i < segmentCount; i++)
+    {
+        MTSegmentInfo *segment = [segments objectAtIndex:i];
+
+        measured[i].vmAddress = [segment vmAddress];
+        measured[i].vmSize = [segment vmSize];
+        measured[i].fileOffset = [segment fileOffset];
+        measured[i].fileSize = [segment fileSize];
+
+        // __PAGEZERO covers 4GB but costs nothing, so don't track it page by page.
+        if ([segment initialProtection] == VM_PROT_NONE && !measured[i].fileSize)
+            measured[i].vmSize = 0;
+
+        measured[i].pageCount = (NSUInteger)((measured[i].vmSize + pageSize - 1) / pageSize);
+        bitmapSize += (measured[i].pageCount + 7) / 8;
+    }
+
+    // One allocation holds the bitmaps for every segment.
+    UInt8 *bitmaps = calloc(bitmapSize ? bitmapSize : 1, sizeof(UInt8));
+
+    if (!bitmaps)
+    {
+        free(measured);
+
+        return nil;
+    }
+
+    for (NSUInteger i = 0, bitmapOffset = 0; i < segmentCount; i++)
+    {
+        measured[i].dirty = bitmaps + bitmapOffset;
+        bitmapOffset += (measured[i].pageCount + 7) / 8;
+    }
+
+    MTFootprintContext context = {
+        .segments = measured,
+        .segmentCount = segmentCount,
+        .pageSize = pageSize,
+        .pointerSize = [image decoder]->pointerSize,
+        .decoder = [image decoder],
+        .imageData = [[image imageData] bytes],
+        .imageSize = [[image imageData] length]
+    };
+
+    if (![footprint applyFixupsForImage:image context:&context])
+    {
+        NSLog(@"Found malformed fixups in image!");
+
+        free(measured);
+        free(bitmaps);
+
+        return nil;
+    }
+
+    NSMutableArray<MTSegmentFootprint *> *results = [[NSMutableArray alloc] initWithCapacity:segmentCount];
+
+    for (NSUInteger i = 0; i < segmentCount; i++)
+    {
+        MTSegmentInfo *segment = [segments objectAtIndex:i];
+        NSUInteger dirtyPages = 0;
+        NSUInteger zeroFillPages = 0;
+
+        for (NSUInteger page = 0; page < measured[i].pageCount; page++)
+        {
+            if (measured[i].dirty[page / 8] & (1 << (page % 8)))
+                dirtyPages++;
+        }
+
+        // Zero fill pages only matter if they can be written. The page holding the end of the file data isn't zero fill.
+        if (([segment initialProtection] & VM_PROT_WRITE) && measured[i].vmSize > measured[i].fileSize)
+            zeroFillPages = measured[i].pageCount - (NSUInteger)((measured[i].fileSize + pageSize - 1) / pageSize);
+
+        [results addObject:[[MTSegmentFootprint alloc] initWithSegment:segment pageCount:measured[i].pageCount dirtyPageCount:dirtyPages zeroFillPageCount:zeroFillPages]];
+    }
+
+    free(measured);
+    free(bitmaps);
+
+    footprint->_pageSize = (NSUInteger)pageSize;
+    footprint->_segments = [results copy];
+
+    return footprint;
+}
+
+#pragma mark Totals
+
+- (NSUInteger) dirtyPageCount
+{
+    NSUInteger count = 0;
+
+    for (MTSegmentFootprint *segment in self->_segments)
+        count += [segment dirtyPageCount];
+
+    return count;
+}
+
+- (NSUInteger) zeroFillPageCount
+{
+    NSUInteger count = 0;
+
+    for (MTSegmentFootprint *segment in self->_segments)
+        count += [segment zeroFillPageCount];
+
+    return count;
+}
+
+- (UInt64) dirtyBytes
+{
+    return (UInt64)[self dirtyPageCount] * self->_pageSize;
+}
+
+- (UInt64) zeroFillBytes
+{
+    return (UInt64)[self zeroFillPageCount] * self->_pageSize;
+}
+
+- (NSUInteger) dirtyPageCountForKind:(MTSegmentKind)kind
+{
+    NSUInteger count = 0;
+
+    for (MTSegmentFootprint *segment in self->_segments)
+    {
+        if ([segment kind] == kind)
+            count += [segment dirtyPageCount];
+    }
+
+    return count;
+}
+
+@end
@@ -1,14 +1,109 @@
 #import <MTool/MTSharedCache.h>
+#import <MTool/MTMachO.h>
 #import <Foundation/Foundation.h>
 
 #import <mach-o/dyld_cache_format.h>
 #import <mach/shared_region.h>
 
+#import "MTSharedCachePrivate.h"
+
 // shared_region_check_np is declared in shared_region.h above, but __shared_region_check_np
 //   is the actual function dyld uses to check for the shared cache...
 extern int __shared_region_check_np(uint64_t *startaddress);
 
+// The cache header has grown over time. Fields only exist if the mappings start after them.
+// This is the same check dyld does (see step 5 and 19.b. in MTSharedCache.h)
+#define MTCacheHeaderHasField(header, field) ((header)->mappingOffset >= offsetof(struct dyld_cache_header, field) + sizeof((header)->field))
+
+#pragma mark - MTSharedCacheImage
+
+@interface MTSharedCacheImage (Private)
+
+- (instancetype) initWithCache:(MTSharedCache *)cache path:(NSString *)path address:(UInt64)address index:(NSUInteger)index;
+
+@end
+
+@implementation MTSharedCacheImage
+{
+    __weak MTSharedCache *_cache;
+}
+
+@synthesize address = _address;
+@synthesize index = _index;
+@synthesize path = _path;
+
+- (instancetype) initWithCache:(MTSharedCache *)cache path:(NSString *)path address:(UInt64)address index:(NSUInteger)index
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->_cache = cache;
+        self->_path = path;
+        self->_address = address;
+        self->_index = index;
+    }
+
+    return self;
+}
+
+- (MTMachO *) image
+{
+    MTSharedCache *cache = self->_cache;
+    const MTSharedCacheMapping *mapping = [cache mappingForAddress:[self address] size:sizeof(struct mach_header_64)];
+
+    if (!mapping)
+    {
+        NSLog(@"Image '%@' is not mapped in cache!", [self path]);
+
+        return nil;
+    }
+
+    void *location = (void *)[cache pointerForAddress:[self address] size:sizeof(struct mach_header_64)];
+    NSUInteger maxSize = (NSUInteger)(mapping->address + mapping->size - [self address]);
+
+    return [MTMachO loadFromMemoryAt:location maxSize:maxSize];
+}
+
+- (NSString *) description
+{
+    return [NSString stringWithFormat:@"%@ @ 0x%08llX", [self path], [self address]];
+}
+
+@end
+
+#pragma mark - MTSharedCache
+
 @implementation MTSharedCache
+{
+    // The main cache is at index 0, followed by any sub-caches in order.
+    NSArray<NSData *> *_files;
+
+    MTSharedCacheMapping *_mappings;
+    NSUInteger _mappingCount;
+
+    NSArray<MTSharedCacheImage *> *_images;
+
+    // Created on first use
+    NSArray<MTSharedCacheRebasedMapping *> *_rebasedMappings;
+
+    NSString *_architecture;
+
+    NSURL *_url;
+    NSUUID *_uuid;
+}
+
+@synthesize url = _url;
+@synthesize uuid = _uuid;
+
+@dynamic architecture;
+@dynamic fileCount;
+@dynamic images;
+
+@dynamic rebasedMappings;
+
+@dynamic mappingCount;
+@dynamic mappings;
 
 + (instancetype) currentSharedCache
 {
@@ -36,9 +131,391 @@ extern int __shared_region_check_np(uint64_t *startaddress);
     return cache;
 }
 
+#pragma mark Loading from files
+
+// Map a single cache file and do some basic validation on the header (steps 3 and 4 in MTSharedCache.h)
++ (NSData *) mapCacheFileAtURL:(NSURL *)url
+{
+    NSError *error;
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedAlways error:&error];
+
+    if (!data)
+    {
+        NSLog(@"Failed to map cache file at URL '%@'! (%@)", url, error);
+
+        return nil;
+    }
+
+    const struct dyld_cache_header *header = (const struct dyld_cache_header *)[data bytes];
+
+    if ([data length] < offsetof(struct dyld_cache_header, mappingCount) + sizeof(header->mappingCount))
+    {
+        NSLog(@"File at URL '%@' is too small for a cache header!", url);
+
+        return nil;
+    }
+
+    // Note: An 8 character architecture name has no padding (ex. 'dyld_v1arm64_32')
+    if (strncmp(header->magic, "dyld_v1", 7) != 0)
+    {
+        NSLog(@"File at URL '%@' has invalid cache magic!", url);
+
+        return nil;
+    }
+
+    if (header->mappingOffset > [data length] || header->mappingCount == 0)
+    {
+        NSLog(@"Cache file at URL '%@' has no mappings!", url);
+
+        return nil;
+    }
+
+    return data;
+}
+
++ (instancetype) loadFromURL:(NSURL *)url
+{
+    NSData *mainFile = [self mapCacheFileAtURL:url];
+
+    if (!mainFile)
+        return nil;
+
+    const struct dyld_cache_header *header = (const struct dyld_cache_header *)[mainFile bytes];
+    NSMutableArray<NSData *> *files = [[NSMutableArray alloc] initWithObjects:mainFile, nil];
+
+    // Sub-caches live next to the main cache. Newer caches name each one in the sub-cache array
+    //   (ex. '.01', '.02', '.dylddata', '.dyldlinkedit'). Older entries have no name, and are just '.1', '.2', ...
+    UInt32 subCacheCount = MTCacheHeaderHasField(header, subCacheArrayCount) ? header->subCacheArrayCount : 0;
+    BOOL hasSuffixes = MTCacheHeaderHasField(header, cacheSubType);
+    NSUInteger entrySize = hasSuffixes ? sizeof(struct dyld_subcache_entry) : sizeof(struct dyld_subcache_entry_v1);
+
+    if (subCacheCount && (UInt64)header->subCacheArrayOffset + ((UInt64)subCacheCount * entrySize) > [mainFile length])
+    {
+        NSLog(@"Sub-cache array extends past end of cache file!");
+
+        return nil;
+    }
+
+    for (UInt32 i = 1; i <= subCacheCount; i++)
+    {
+        NSString *suffix;
+
+        if (hasSuffixes) {
+            const struct dyld_subcache_entry *entry = (const struct dyld_subcache_entry *)((const UInt8 *)[mainFile bytes] + header->subCacheArrayOffset) + (i - 1);
+
+            suffix = [[NSString alloc] initWithBytes:entry->fileSuffix length:strnlen(entry->fileSuffix, sizeof(entry->fileSuffix)) encoding:NSUTF8StringEncoding];
+        } else {
+            suffix = [NSString stringWithFormat:@".%u", i];
+        }
+
+        if (![suffix length])
+        {
+            NSLog(@"Sub-cache %u of %u has no file suffix!", i, subCacheCount);
+
+            return nil;
+        }
+
+        NSURL *subCacheURL = [NSURL fileURLWithPath:[[url path] stringByAppendingString:suffix]];
+        NSData *subCache = [self mapCacheFileAtURL:subCacheURL];
+
+        if (!subCache)
+        {
+            NSLog(@"Failed to load sub-cache %u of %u ('%@')!", i, subCacheCount, suffix);
+
+            return nil;
+        }
+
+        [files addObject:subCache];
+    }
+
+    MTSharedCache *instance = [[MTSharedCache alloc] init];
+
+    if (instance)
+    {
+        instance->_files = [files copy];
+        instance->_url = url;
+        instance->_uuid = [[NSUUID alloc] initWithUUIDBytes:header->uuid];
+
+        // The architecture is padded on the left with spaces to 8 bytes.
+        NSString *magic = [[NSString alloc] initWithBytes:(header->magic + 7) length:strnlen(header->magic + 7, 9) encoding:NSUTF8StringEncoding];
+        instance->_architecture = [magic stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+
+        if (![instance readMappings] || ![instance readImages])
+            return nil;
+    }
+
+    return instance;
+}
+
+- (BOOL) readMappings
+{
+    NSUInteger totalCount = 0;
+
+    for (NSData *file in self->_files)
+        totalCount += ((const struct dyld_cache_header *)[file bytes])->mappingCount;
+
+    self->_mappings = calloc(totalCount, sizeof(MTSharedCacheMapping));
+
+    if (!self->_mappings)
+    {
+        NSLog(@"Out of memory!");
+
+        return NO;
+    }
+
+    for (NSUInteger i = 0; i < [self->_files count]; i++)
+    {
+        const UInt8 *base = [self baseOfFile:i];
+        NSUInteger length = [self sizeOfFile:i];
+
+        const struct dyld_cache_header *header = (const struct dyld_cache_header *)base;
+
+        // Newer caches have per-mapping slide info. Older caches only have slide info for the data mapping (1)
+        BOOL hasSlideMappings = MTCacheHeaderHasField(header, mappingWithSlideCount) && header->mappingWithSlideCount == header->mappingCount;
+        NSUInteger entrySize = hasSlideMappings ? sizeof(struct dyld_cache_mapping_and_slide_info) : sizeof(struct dyld_cache_mapping_info);
+        NSUInteger tableOffset = hasSlideMappings ? header->mappingWithSlideOffset : header->mappingOffset;
+
+        if (tableOffset + (header->mappingCount * entrySize) > length)
+        {
+            NSLog(@"Cache file %lu mapping table extends past end of file!", (unsigned long)i);
+
+            return NO;
+        }
+
+        for (UInt32 j = 0; j < header->mappingCount; j++)
+        {
+            MTSharedCacheMapping *mapping = &self->_mappings[self->_mappingCount++];
+            mapping->fileIndex = (UInt32)i;
+
+            if (hasSlideMappings) {
+                const struct dyld_cache_mapping_and_slide_info *entry = (const struct dyld_cache_mapping_and_slide_info *)(base + tableOffset + (j * entrySize));
+
+                mapping->address = entry->address;
+                mapping->size = entry->size;
+                mapping->fileOffset = entry->fileOffset;
+                mapping->slideInfoOffset = entry->slideInfoFileOffset;
+                mapping->slideInfoSize = entry->slideInfoFileSize;
+                mapping->flags = entry->flags;
+                mapping->maxProtection = entry->maxProt;
+                mapping->initialProtection = entry->initProt;
+            } else {
+                const struct dyld_cache_mapping_info *entry = (const struct dyld_cache_mapping_info *)(base + tableOffset + (j * entrySize));
+
+                mapping->address = entry->address;
+                mapping->size = entry->size;
+                mapping->fileOffset = entry->fileOffset;
+                mapping->maxProtection = entry->maxProt;
+                mapping->initialProtection = entry->initProt;
+
+                if (j == 1 && MTCacheHeaderHasField(header, slideInfoSizeUnused))
+                {
+                    mapping->slideInfoOffset = header->slideInfoOffsetUnused;
+                    mapping->slideInfoSize = header->slideInfoSizeUnused;
+                }
+            }
+
+            if (mapping->fileOffset + mapping->size > length)
+            {
+                NSLog(@"Cache file %lu mapping %u extends past end of file!", (unsigned long)i, j);
+
+                return NO;
+            }
+
+            if (mapping->slideInfoSize && mapping->slideInfoOffset + mapping->slideInfoSize > length)
+            {
+                NSLog(@"Cache file %lu mapping %u has slide info past end of file!", (unsigned long)i, j);
+
+                return NO;
+            }
+        }
+    }
+
+    return YES;
+}
+
+- (BOOL) readImages
+{
+    const UInt8 *base = [self baseOfFile:0];
+    NSUInteger length = [self sizeOfFile:0];
+
+    const struct dyld_cache_header *header = (const struct dyld_cache_header *)base;
+
+    // Caches with sub-caches moved the image list to a new location in the header.
+    UInt32 imagesOffset = header->imagesOffsetOld;
+    UInt32 imagesCount = header->imagesCountOld;
+
+    if (MTCacheHeaderHasField(header, imagesCount) && header->imagesCount)
+    {
+        imagesOffset = header->imagesOffset;
+        imagesCount = header->imagesCount;
+    }
+
+    if (imagesOffset + ((UInt64)imagesCount * sizeof(struct dyld_cache_image_info)) > length)
+    {
+        NSLog(@"Cache image list extends past end of file!");
+
+        return NO;
+    }
+
+    NSMutableArray<MTSharedCacheImage *> *images = [[NSMutableArray alloc] initWithCapacity:imagesCount];
+    const struct dyld_cache_image_info *info = (const struct dyld_cache_image_info *)(base + imagesOffset);
+
+    for (UInt32 i = 0; i < imagesCount; i++)
+    {
+        if (info[i].pathFileOffset >= length)
+        {
+            NSLog(@"Cache image %u has path outside of cache file!", i);
+
+            return NO;
+        }
+
+        const char *path = (const char *)(base + info[i].pathFileOffset);
+        NSString *pathString = [[NSString alloc] initWithBytes:path length:strnlen(path, length - info[i].pathFileOffset) encoding:NSUTF8StringEncoding];
+
+        [images addObject:[[MTSharedCacheImage alloc] initWithCache:self path:pathString address:info[i].address index:i]];
+    }
+
+    self->_images = [images copy];
+    return YES;
+}
+
+#pragma mark Property getters
+
+- (NSString *) architecture
+{
+    return self->_architecture;
+}
+
+- (NSArray<MTSharedCacheImage *> *) images
+{
+    return self->_images;
+}
+
+- (NSUInteger) fileCount
+{
+    return [self->_files count];
+}
+
+- (const MTSharedCacheMapping *) mappings
+{
+    return self->_mappings;
+}
+
+- (NSUInteger) mappingCount
+{
+    return self->_mappingCount;
+}
+
+- (const UInt8 *) baseOfFile:(NSUInteger)index
+{
+    return (const UInt8 *)[[self->_files objectAtIndex:index] bytes];
+}
+
+- (NSUInteger) sizeOfFile:(NSUInteger)index
+{
+    return [[self->_files objectAtIndex:index] length];
+}
+
+#pragma mark Address translation
+
+- (const MTSharedCacheMapping *) mappingForAddress:(UInt64)address size:(UInt64)size
+{
+    // There are only ever a handful of mappings, so a linear search is fine here.
+    for (NSUInteger i = 0; i < self->_mappingCount; i++)
+    {
+        const MTSharedCacheMapping *mapping = &self->_mappings[i];
+
+        if (address >= mapping->address && address - mapping->address + size <= mapping->size)
+            return mapping;
+    }
+
+    return NULL;
+}
+
+- (const void *) pointerForAddress:(UInt64)address size:(UInt64)size
+{
+    const MTSharedCacheMapping *mapping = [self mappingForAddress:address size:size];
+
+    if (!mapping)
+        return NULL;
+
+    return [self baseOfFile:mapping->fileIndex] + mapping->fileOffset + (address - mapping->address);
+}
+
+#pragma mark Rebased views
+
+- (NSArray<MTSharedCacheRebasedMapping *> *) rebasedMappings
+{
+    @synchronized (self)
+    {
+        if (self->_rebasedMappings)
+            return self->_rebasedMappings;
+
+        NSMutableArray<MTSharedCacheRebasedMapping *> *rebasedMappings = [[NSMutableArray alloc] init];
+
+        for (NSUInteger i = 0; i < self->_mappingCount; i++)
+        {
+            const MTSharedCacheMapping *mapping = &self->_mappings[i];
+
+            if (!mapping->slideInfoSize)
+                continue;
+
+            // Creating these is cheap. Nothing is rebased until it's accessed.
+            MTSharedCacheRebasedMapping *rebased = [[MTSharedCacheRebasedMapping alloc] initWithMapping:mapping file:[self->_files objectAtIndex:mapping->fileIndex] slide:0];
+
+            if (rebased)
+                [rebasedMappings addObject:rebased];
+        }
+
+        self->_rebasedMappings = [rebasedMappings copy];
+        return self->_rebasedMappings;
+    }
+}
+
+- (const void *) rebasedPointerForAddress:(UInt64)address size:(UInt64)size
+{
+    for (MTSharedCacheRebasedMapping *mapping in [self rebasedMappings])
+    {
+        if (address >= [mapping address] && address < [mapping address] + [mapping size])
+            return [mapping pointerForAddress:address size:size];
+    }
+
+    for (NSUInteger i = 0; i < self->_mappingCount; i++)
+    {
+        const MTSharedCacheMapping *mapping = &self->_mappings[i];
+
+        // Slide info we couldn't use. Handing back the raw bytes would leave pointers encoded.
+        if (mapping->slideInfoSize && address >= mapping->address && address < mapping->address + mapping->size)
+            return NULL;
+    }
+
+    // Mappings without slide info don't have any pointers to fix.
+    return [self pointerForAddress:address size:size];
+}
+
+- (BOOL) rebaseAllMappings
+{
+    BOOL result = YES;
+
+    // Each mapping already rebases its pages in parallel.
+    for (MTSharedCacheRebasedMapping *mapping in [self rebasedMappings])
+    {
+        if (![mapping rebaseAllPages])
+            result = NO;
+    }
+
+    return result;
+}
+
 - (BOOL) readFromMemory:(void *)address isLoaded:(BOOL)isLoaded
 {
     return YES;
 }
 
+- (void) dealloc
+{
+    if (self->_mappings)
+        free(self->_mappings);
+}
+
 @end
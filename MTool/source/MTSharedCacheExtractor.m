@@ -0,0 +1,533 @@
+#import <MTool/MTool.h>
+#import <MTool/MTSharedCacheExtractor.h>
+
+#import <mach-o/loader.h>
+#import <mach-o/nlist.h>
+
+// For open, pwrite, ftruncate, mkstemp, rename
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/stat.h>
+
+// For counting extracted images across workers
+#import <stdatomic.h>
+
+#import "MTImageDecoder.h"
+#import "MTSharedCachePrivate.h"
+
+// Everything appended to a rebuilt __LINKEDIT is aligned to this
+#define kMTExtractLinkeditAlignment 8
+
+// Where a segment is copied from in the cache and where it goes in the extracted image
+typedef struct {
+    UInt64 address;
+    UInt64 size;
+    UInt64 fileOffset;
+} MTExtractedSegment;
+
+static UInt64 MTRoundUp(UInt64 value, UInt64 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// pwrite() may write less than requested, so keep going until everything is out.
+static BOOL MTPositionedWrite(int fd, const void *buffer, size_t size, off_t offset)
+{
+    const UInt8 *bytes = (const UInt8 *)buffer;
+
+    while (size)
+    {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return NO;
+        }
+
+        bytes += written;
+        offset += written;
+        size -= written;
+    }
+
+    return YES;
+}
+
+// Append to a __LINKEDIT under construction, returning the (aligned) offset of the new data.
+static UInt32 MTLinkeditAppend(NSMutableData *linkedit, const void *bytes, NSUInteger length)
+{
+    [linkedit setLength:MTRoundUp([linkedit length], kMTExtractLinkeditAlignment)];
+
+    UInt32 offset = (UInt32)[linkedit length];
+    [linkedit appendBytes:bytes length:length];
+
+    return offset;
+}
+
+// Install names are absolute, so they're just nested under the output directory. They come straight from the cache
+//   though, so refuse anything that would climb out of it. Returns nil for names that can't be used.
+static NSString *MTExtractOutputPath(NSString *directory, NSString *installName)
+{
+    NSMutableArray<NSString *> *components = [[NSMutableArray alloc] init];
+
+    for (NSString *component in [installName pathComponents])
+    {
+        if ([component isEqualToString:@".."])
+            return nil;
+
+        if (![component isEqualToString:@"/"] && ![component isEqualToString:@"."])
+            [components addObject:component];
+    }
+
+    if (![components count])
+        return nil;
+
+    return [directory stringByAppendingPathComponent:[NSString pathWithComponents:components]];
+}
+
+@implementation MTSharedCache (Extraction)
+
+// Translate an offset in the shared __LINKEDIT (as referenced by the image's load commands) to a pointer.
+- (const UInt8 *) pointerForLinkeditOffset:(UInt64)offset size:(UInt64)size linkedit:(const struct segment_command_64 *)linkedit
+{
+    if (offset < linkedit->fileoff)
+        return NULL;
+
+    return [self pointerForAddress:(linkedit->vmaddr + (offset - linkedit->fileoff)) size:size];
+}
+
+- (BOOL) extractImage:(MTSharedCacheImage *)image toURL:(NSURL *)url
+{
+    UInt64 address = [image address];
+    const UInt8 *headerBytes = [self pointerForAddress:address size:sizeof(struct mach_header_64)];
+
+    if (!headerBytes)
+    {
+        NSLog(@"Image '%@' is not mapped in cache!", [image path]);
+
+        return NO;
+    }
+
+    const MTImageDecoder *decoder = MTImageDecoderForImage(headerBytes);
+
+    // Cached images are always native endian. We only rewrite 64 bit load commands for now.
+    if (!decoder || !decoder->is64bit || decoder->isSwapped)
+    {
+        NSLog(@"Image '%@' is not a 64 bit native Mach-O image!", [image path]);
+
+        return NO;
+    }
+
+    struct mach_header_64 header;
+    decoder->readHeader(headerBytes, &header);
+
+    const UInt8 *sourceCommands = [self pointerForAddress:address size:(sizeof(struct mach_header_64) + header.sizeofcmds)];
+
+    if (!sourceCommands)
+    {
+        NSLog(@"Load commands for image '%@' are not mapped in cache!", [image path]);
+
+        return NO;
+    }
+
+    sourceCommands += sizeof(struct mach_header_64);
+
+    // Copy the commands we keep. All patching happens in place in this copy.
+    NSMutableData *commandData = [NSMutableData dataWithLength:header.sizeofcmds];
+    UInt8 *commands = (UInt8 *)[commandData mutableBytes];
+    UInt32 commandsSize = 0;
+    UInt32 commandCount = 0;
+
+    size_t offset = 0;
+
+    for (uint32_t i = 0; i < header.ncmds; i++)
+    {
+        if (offset + sizeof(struct load_command) > header.sizeofcmds)
+        {
+            NSLog(@"Found load commands past end of expected section!");
+
+            return NO;
+        }
+
+        const struct load_command *command = (const struct load_command *)(sourceCommands + offset);
+
+        if (command->cmdsize < sizeof(struct load_command) || offset + command->cmdsize > header.sizeofcmds)
+        {
+            NSLog(@"Found command with too small/large size in image!");
+
+            return NO;
+        }
+
+        offset += command->cmdsize;
+
+        switch (command->cmd)
+        {
+            // None of these are meaningful outside the cache.
+            case LC_SEGMENT_SPLIT_INFO:
+            case LC_CODE_SIGNATURE:
+            case LC_DYLIB_CODE_SIGN_DRS:
+            case LC_DYLD_CHAINED_FIXUPS:
+                continue;
+            default:
+                break;
+        }
+
+        memcpy(commands + commandsSize, command, command->cmdsize);
+        commandsSize += command->cmdsize;
+        commandCount++;
+    }
+
+    // First, lay out every segment other than __LINKEDIT in file order.
+    // Addresses are preserved, so only file offsets change.
+    UInt64 pageSize = (header.cputype == CPU_TYPE_ARM64 || header.cputype == CPU_TYPE_ARM64_32) ? 0x4000 : 0x1000;
+    NSMutableData *segmentData = [NSMutableData dataWithLength:(commandCount * sizeof(MTExtractedSegment))];
+    MTExtractedSegment *segments = (MTExtractedSegment *)[segmentData mutableBytes];
+    NSUInteger segmentCount = 0;
+
+    struct segment_command_64 *linkedit = NULL;
+    struct segment_command_64 sourceLinkedit = {0};
+    UInt64 fileOffset = 0;
+
+    for (offset = 0; offset < commandsSize; offset += ((struct load_command *)(commands + offset))->cmdsize)
+    {
+        struct load_command *command = (struct load_command *)(commands + offset);
+
+        if (command->cmd != LC_SEGMENT_64)
+            continue;
+
+        if (command->cmdsize < sizeof(struct segment_command_64))
+        {
+            NSLog(@"Found undersized segment command (64 bit) in image!");
+
+            return NO;
+        }
+
+        struct segment_command_64 *segment = (struct segment_command_64 *)command;
+
+        if (segment->nsects * sizeof(struct section_64) > command->cmdsize - sizeof(struct segment_command_64))
+        {
+            NSLog(@"Segment '%.16s' has more sections than fit in its command!", segment->segname);
+
+            return NO;
+        }
+
+        if (!strncmp(segment->segname, SEG_LINKEDIT, sizeof(segment->segname)))
+        {
+            sourceLinkedit = (*segment);
+            linkedit = segment;
+
+            continue;
+        }
+
+        UInt64 newOffset = fileOffset;
+
+        if (segment->filesize)
+        {
+            segments[segmentCount].address = segment->vmaddr;
+            segments[segmentCount].size = segment->filesize;
+            segments[segmentCount].fileOffset = newOffset;
+            segmentCount++;
+
+            fileOffset = MTRoundUp(newOffset + segment->filesize, pageSize);
+        }
+
+        struct section_64 *sections = (struct section_64 *)(segment + 1);
+
+        for (uint32_t j = 0; j < segment->nsects; j++)
+        {
+            UInt32 type = (sections[j].flags & SECTION_TYPE);
+
+            if (type == S_ZEROFILL || type == S_GB_ZEROFILL || type == S_THREAD_LOCAL_ZEROFILL || !sections[j].offset)
+                continue;
+
+            sections[j].offset = (UInt32)(newOffset + (sections[j].addr - segment->vmaddr));
+        }
+
+        segment->fileoff = newOffset;
+    }
+
+    if (!linkedit)
+    {
+        NSLog(@"Image '%@' has no __LINKEDIT segment!", [image path]);
+
+        return NO;
+    }
+
+    // Now we can rebuild __LINKEDIT, since we know where it's going to go.
+    NSMutableData *newLinkedit = [[NSMutableData alloc] init];
+    UInt64 linkeditOffset = fileOffset;
+
+    struct symtab_command *symtab = NULL;
+    struct dysymtab_command *dysymtab = NULL;
+
+    for (offset = 0; offset < commandsSize; offset += ((struct load_command *)(commands + offset))->cmdsize)
+    {
+        struct load_command *command = (struct load_command *)(commands + offset);
+
+        switch (command->cmd)
+        {
+            case LC_DYLD_INFO:
+            case LC_DYLD_INFO_ONLY: {
+                struct dyld_info_command *info = (struct dyld_info_command *)command;
+
+                // Pointers in the extracted image are written out fixed up, so there's nothing to rebase or bind.
+                info->rebase_off = info->rebase_size = 0;
+                info->bind_off = info->bind_size = 0;
+                info->weak_bind_off = info->weak_bind_size = 0;
+                info->lazy_bind_off = info->lazy_bind_size = 0;
+
+                if (info->export_size)
+                {
+                    const UInt8 *exports = [self pointerForLinkeditOffset:info->export_off size:info->export_size linkedit:&sourceLinkedit];
+
+                    if (!exports)
+                    {
+                        NSLog(@"Export info for image '%@' is outside of __LINKEDIT!", [image path]);
+
+                        return NO;
+                    }
+
+                    info->export_off = (UInt32)(linkeditOffset + MTLinkeditAppend(newLinkedit, exports, info->export_size));
+                } else {
+                    info->export_off = 0;
+                }
+            } break;
+            case LC_DYLD_EXPORTS_TRIE:
+            case LC_FUNCTION_STARTS:
+            case LC_DATA_IN_CODE: {
+                struct linkedit_data_command *data = (struct linkedit_data_command *)command;
+
+                if (!data->datasize)
+                {
+                    data->dataoff = 0;
+
+                    continue;
+                }
+
+                const UInt8 *source = [self pointerForLinkeditOffset:data->dataoff size:data->datasize linkedit:&sourceLinkedit];
+
+                if (!source)
+                {
+                    NSLog(@"%@ for image '%@' is outside of __LINKEDIT!", MTMachOLoadCommandName(command->cmd), [image path]);
+
+                    return NO;
+                }
+
+                data->dataoff = (UInt32)(linkeditOffset + MTLinkeditAppend(newLinkedit, source, data->datasize));
+            } break;
+            // These are handled together below
+            case LC_SYMTAB:   symtab = (struct symtab_command *)command;        break;
+            case LC_DYSYMTAB: dysymtab = (struct dysymtab_command *)command;    break;
+            default:
+                break;
+        }
+    }
+
+    // Symbols, then indirect symbols, then strings. This is the same order ld64 uses.
+    if (symtab)
+    {
+        const struct nlist_64 *sourceSymbols = (const struct nlist_64 *)[self pointerForLinkeditOffset:symtab->symoff size:((UInt64)symtab->nsyms * sizeof(struct nlist_64)) linkedit:&sourceLinkedit];
+        const char *sourceStrings = (const char *)[self pointerForLinkeditOffset:symtab->stroff size:symtab->strsize linkedit:&sourceLinkedit];
+
+        if ((symtab->nsyms && !sourceSymbols) || !sourceStrings)
+        {
+            NSLog(@"Symbol table for image '%@' is outside of __LINKEDIT!", [image path]);
+
+            return NO;
+        }
+
+        // The cache string pool is shared by every image, so we build a new one with only our strings.
+        NSMutableData *symbolData = [NSMutableData dataWithBytes:sourceSymbols length:(symtab->nsyms * sizeof(struct nlist_64))];
+        NSMutableData *strings = [NSMutableData dataWithLength:1];
+        struct nlist_64 *symbols = (struct nlist_64 *)[symbolData mutableBytes];
+
+        for (uint32_t i = 0; i < symtab->nsyms; i++)
+        {
+            if (!symbols[i].n_un.n_strx)
+                continue;
+
+            if (symbols[i].n_un.n_strx >= symtab->strsize)
+            {
+                NSLog(@"Symbol %u in image '%@' has name outside of string table!", i, [image path]);
+
+                return NO;
+            }
+
+            const char *name = sourceStrings + symbols[i].n_un.n_strx;
+            size_t length = strnlen(name, symtab->strsize - symbols[i].n_un.n_strx);
+
+            symbols[i].n_un.n_strx = (UInt32)[strings length];
+            [strings appendBytes:name length:length];
+            [strings increaseLengthBy:1];
+        }
+
+        symtab->symoff = (UInt32)(linkeditOffset + MTLinkeditAppend(newLinkedit, [symbolData bytes], [symbolData length]));
+
+        if (dysymtab)
+        {
+            if (dysymtab->nindirectsyms)
+            {
+                const UInt8 *indirect = [self pointerForLinkeditOffset:dysymtab->indirectsymoff size:(dysymtab->nindirectsyms * sizeof(UInt32)) linkedit:&sourceLinkedit];
+
+                if (!indirect)
+                {
+                    NSLog(@"Indirect symbol table for image '%@' is outside of __LINKEDIT!", [image path]);
+
+                    return NO;
+                }
+
+                dysymtab->indirectsymoff = (UInt32)(linkeditOffset + MTLinkeditAppend(newLinkedit, indirect, dysymtab->nindirectsyms * sizeof(UInt32)));
+            }
+
+            // None of these tables are used by modern images.
+            dysymtab->tocoff = dysymtab->ntoc = 0;
+            dysymtab->modtaboff = dysymtab->nmodtab = 0;
+            dysymtab->extrefsymoff = dysymtab->nextrefsyms = 0;
+            dysymtab->extreloff = dysymtab->nextrel = 0;
+            dysymtab->locreloff = dysymtab->nlocrel = 0;
+        }
+
+        symtab->stroff = (UInt32)(linkeditOffset + MTLinkeditAppend(newLinkedit, [strings bytes], [strings length]));
+        symtab->strsize = (UInt32)MTRoundUp([strings length], kMTExtractLinkeditAlignment);
+    }
+
+    [newLinkedit setLength:MTRoundUp([newLinkedit length], kMTExtractLinkeditAlignment)];
+
+    linkedit->fileoff = linkeditOffset;
+    linkedit->filesize = [newLinkedit length];
+    linkedit->vmsize = MTRoundUp([newLinkedit length], pageSize);
+
+    // This image isn't in the cache anymore.
+    struct mach_header_64 newHeader = header;
+    newHeader.flags &= ~MH_DYLIB_IN_CACHE;
+    newHeader.ncmds = commandCount;
+    newHeader.sizeofcmds = commandsSize;
+
+    return [self writeImage:image
+                     header:&newHeader
+                   commands:commands
+             originalLength:header.sizeofcmds
+                   segments:segments
+                      count:segmentCount
+                   linkedit:newLinkedit
+                     offset:linkeditOffset
+                      toURL:url];
+}
+
+- (BOOL) writeImage:(MTSharedCacheImage *)image header:(const struct mach_header_64 *)header commands:(const UInt8 *)commands originalLength:(UInt32)originalLength segments:(const MTExtractedSegment *)segments count:(NSUInteger)count linkedit:(NSData *)linkedit offset:(UInt64)linkeditOffset toURL:(NSURL *)url
+{
+    NSError *error;
+
+    if (![[NSFileManager defaultManager] createDirectoryAtURL:[url URLByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:&error])
+    {
+        NSLog(@"Failed to create directory for '%@'! (%@)", url, error);
+
+        return NO;
+    }
+
+    // Write next to the output and rename into place, so a failed extraction never leaves a partial image behind.
+    NSString *temporaryName = [NSString stringWithFormat:@".%@.extract.XXXXXX", [url lastPathComponent]];
+    char *temporary = strdup([[[[url path] stringByDeletingLastPathComponent] stringByAppendingPathComponent:temporaryName] fileSystemRepresentation]);
+
+    if (!temporary)
+        return NO;
+
+    int fd = mkstemp(temporary);
+
+    if (fd < 0)
+    {
+        NSLog(@"Failed to create temporary file for '%@'! (%s)", url, strerror(errno));
+
+        free(temporary);
+        return NO;
+    }
+
+    // mkstemp() creates files 0600. Extracted images should be readable like any other library.
+    // Size the file up front. This way, workers never need to extend a file while writing.
+    BOOL result = !fchmod(fd, 0644) && !ftruncate(fd, (off_t)(linkeditOffset + [linkedit length]));
+
+    for (NSUInteger i = 0; result && i < count; i++)
+    {
+        // Data segments are read through the rebased view so pointers in the output are fixed up.
+        const void *source = [self rebasedPointerForAddress:segments[i].address size:segments[i].size];
+
+        if (!source)
+        {
+            NSLog(@"Segment at 0x%08llX in image '%@' is not mapped in cache or can't be rebased!", segments[i].address, [image path]);
+
+            close(fd);
+            unlink(temporary);
+            free(temporary);
+            return NO;
+        }
+
+        result = MTPositionedWrite(fd, source, segments[i].size, segments[i].fileOffset);
+    }
+
+    // The first segment still has the cached header and load commands. Overwrite them.
+    // Dropped load commands are zeroed out by writing the padding explicitly.
+    if (result)
+    {
+        NSMutableData *headerData = [NSMutableData dataWithBytes:header length:sizeof(struct mach_header_64)];
+        [headerData appendBytes:commands length:header->sizeofcmds];
+        [headerData increaseLengthBy:(originalLength - header->sizeofcmds)];
+
+        result = MTPositionedWrite(fd, [headerData bytes], [headerData length], 0);
+    }
+
+    if (result)
+        result = MTPositionedWrite(fd, [linkedit bytes], [linkedit length], (off_t)linkeditOffset);
+
+    if (result)
+        result = !rename(temporary, [[url path] fileSystemRepresentation]);
+
+    if (!result)
+    {
+        NSLog(@"Failed to write image '%@' to '%@'! (%s)", [image path], url, strerror(errno));
+
+        unlink(temporary);
+    }
+
+    close(fd);
+    free(temporary);
+    return result;
+}
+
+- (NSUInteger) extractImages:(NSArray<MTSharedCacheImage *> *)images toDirectory:(NSURL *)directory
+{
+    atomic_ulong extractedCount = 0;
+    atomic_ulong *extracted = &extractedCount;
+
+    // Nearly every data page is written out by someone, so rebase everything up front in parallel
+    //   rather than having workers fault pages in one at a time.
+    if (![self rebaseAllMappings])
+        NSLog(@"Warning: Some cache pages could not be rebased. Pointers in extracted images may be wrong!");
+
+    // Workers only share the (read only) cache mapping. Each writes its own file with pwrite().
+    dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+
+    dispatch_apply([images count], queue, ^(size_t i) {
+        @autoreleasepool
+        {
+            MTSharedCacheImage *image = [images objectAtIndex:i];
+
+            NSString *path = MTExtractOutputPath([directory path], [image path]);
+
+            if (!path)
+            {
+                NSLog(@"Skipping image %lu with unusable install name '%@'!", (unsigned long)[image index], [image path]);
+
+                return;
+            }
+
+            if ([self extractImage:image toURL:[NSURL fileURLWithPath:path]])
+                atomic_fetch_add(extracted, 1);
+        }
+    });
+
+    return (NSUInteger)atomic_load(&extractedCount);
+}
+
+@end
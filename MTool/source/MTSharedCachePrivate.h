@@ -0,0 +1,56 @@
+// This is a private header. It is not exported from the MTool framework.
+#pragma once
+
+#import <MTool/MTSharedCache.h>
+
+// For vm_prot_t
+#import <mach/vm_prot.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// This is a merged view of `struct dyld_cache_mapping_info` and `struct dyld_cache_mapping_and_slide_info`
+//   for a mapping in any of the files making up a cache.
+// Older caches which only have the former are normalized to look like the latter (see step 19.b. in MTSharedCache.h)
+typedef struct {
+    UInt64 address;
+    UInt64 size;
+    UInt64 fileOffset;
+
+    // Offset of the slide info for this mapping in the file containing the mapping. Size is 0 if there is none.
+    UInt64 slideInfoOffset;
+    UInt64 slideInfoSize;
+
+    // DYLD_CACHE_MAPPING_* flags
+    UInt64 flags;
+
+    vm_prot_t maxProtection;
+    vm_prot_t initialProtection;
+
+    // Index into the cache file list
+    UInt32 fileIndex;
+} MTSharedCacheMapping;
+
+@interface MTSharedCacheRebasedMapping (Private)
+
+// Returns nil if the mapping has no slide info, or a slide info version we don't handle.
+- (nullable instancetype) initWithMapping:(const MTSharedCacheMapping *)mapping file:(NSData *)file slide:(UInt64)slide;
+
+@end
+
+@interface MTSharedCache (Private)
+
+@property (nonatomic, readonly) const MTSharedCacheMapping *mappings;
+
+@property (nonatomic, readonly) NSUInteger mappingCount;
+
+// Start of the mapped file at `index` in our address space
+- (const UInt8 *) baseOfFile:(NSUInteger)index;
+
+- (NSUInteger) sizeOfFile:(NSUInteger)index;
+
+// Find the mapping containing [address, address + size). Returns NULL if not fully contained in one mapping.
+- (nullable const MTSharedCacheMapping *) mappingForAddress:(UInt64)address size:(UInt64)size;
+
+@end
+
+NS_ASSUME_NONNULL_END
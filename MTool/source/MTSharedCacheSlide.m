@@ -0,0 +1,509 @@
+#import <MTool/MTool.h>
+#import <MTool/MTSharedCache.h>
+
+#import <mach-o/dyld_cache_format.h>
+
+// For mmap, munmap
+#import <sys/mman.h>
+
+// For page states shared between threads
+#import <stdatomic.h>
+
+// For sched_yield
+#import <sched.h>
+
+#import "MTSharedCachePrivate.h"
+
+// Version 5 slide info is newer than the dyld headers we build against. This matches the layout in dyld.
+struct MTCacheSlideInfo5 {
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t page_starts_count;
+    uint64_t value_add;
+    uint16_t page_starts[];
+};
+
+#define kMTCacheSlideV5PageNoRebase 0xFFFF
+
+// Every page goes untouched --> in progress --> rebased exactly once.
+// Whoever moves a page to "in progress" rebases it. Anyone else that needs it waits.
+enum {
+    kMTPageStateUntouched   = 0,
+    kMTPageStateInProgress  = 1,
+    kMTPageStateRebased     = 2
+};
+
+// Everything needed to rebase a page, so the hot path doesn't need to go through objc_msgSend.
+typedef struct {
+    const UInt8 *slideInfo;
+    UInt64 slideInfoSize;
+    UInt32 version;
+
+    // Raw mapping contents, and our copy which gets rebased.
+    const UInt8 *source;
+    UInt8 *destination;
+    UInt64 size;
+
+    UInt32 pageSize;
+    NSUInteger pageCount;
+
+    UInt64 slide;
+
+    _Atomic(UInt8) *pageStates;
+    atomic_ulong rebasedPageCount;
+    atomic_bool malformed;
+} MTSlideContext;
+
+#pragma mark - Per-page rebasing
+
+static UInt64 MTReadValue(const UInt8 *location, UInt32 size)
+{
+    if (size == sizeof(UInt32))
+    {
+        UInt32 value;
+        memcpy(&value, location, sizeof(UInt32));
+
+        return value;
+    }
+
+    UInt64 value;
+    memcpy(&value, location, sizeof(UInt64));
+
+    return value;
+}
+
+static void MTWriteValue(UInt8 *location, UInt64 value, UInt32 size)
+{
+    if (size == sizeof(UInt32)) {
+        UInt32 value32 = (UInt32)value;
+        memcpy(location, &value32, sizeof(UInt32));
+    } else {
+        memcpy(location, &value, sizeof(UInt64));
+    }
+}
+
+// Version 2: Pointers are chained, with the delta to the next pointer stored in the bits of `delta_mask`
+static BOOL MTRebaseChainV2(const struct dyld_cache_slide_info2 *info, UInt8 *page, UInt64 pageLength, UInt64 offset, UInt64 slide)
+{
+    // Deltas are stored in units of 4 bytes. 32 bit caches have no bits set above the low word.
+    UInt32 pointerSize = (info->delta_mask > UINT32_MAX) ? sizeof(UInt64) : sizeof(UInt32);
+    UInt64 deltaShift = __builtin_ctzll(info->delta_mask) - 2;
+    UInt64 valueMask = ~info->delta_mask;
+    UInt64 delta = 1;
+
+    while (delta)
+    {
+        if (offset + pointerSize > pageLength)
+            return NO;
+
+        UInt8 *location = page + offset;
+        UInt64 raw = MTReadValue(location, pointerSize);
+        UInt64 value = (raw & valueMask);
+
+        delta = (raw & info->delta_mask) >> deltaShift;
+
+        if (value)
+            value += info->value_add + slide;
+
+        MTWriteValue(location, value, pointerSize);
+        offset += delta;
+    }
+
+    return YES;
+}
+
+static BOOL MTRebasePageV2(const MTSlideContext *context, NSUInteger index, UInt8 *page, UInt64 pageLength)
+{
+    const struct dyld_cache_slide_info2 *info = (const struct dyld_cache_slide_info2 *)context->slideInfo;
+
+    if (index >= info->page_starts_count)
+        return NO;
+
+    const UInt16 *starts = (const UInt16 *)(context->slideInfo + info->page_starts_offset);
+    const UInt16 *extras = (const UInt16 *)(context->slideInfo + info->page_extras_offset);
+    UInt16 start = starts[index];
+
+    if (start == DYLD_CACHE_SLIDE_PAGE_ATTR_NO_REBASE)
+        return YES;
+
+    if (!(start & DYLD_CACHE_SLIDE_PAGE_ATTR_EXTRA))
+        return MTRebaseChainV2(info, page, pageLength, (start & 0x3FFF) * 4, context->slide);
+
+    // Pages with more than one chain keep a list of chain starts in the extras.
+    for (UInt32 i = (start & 0x3FFF); ; i++)
+    {
+        if (i >= info->page_extras_count)
+            return NO;
+
+        UInt16 extra = extras[i];
+
+        if (!MTRebaseChainV2(info, page, pageLength, (extra & 0x3FFF) * 4, context->slide))
+            return NO;
+
+        if (extra & DYLD_CACHE_SLIDE_PAGE_ATTR_END)
+            return YES;
+    }
+}
+
+// Version 3: arm64e. Chains are in units of 8 bytes, authenticated pointers are offsets from the cache base.
+static BOOL MTRebasePageV3(const MTSlideContext *context, NSUInteger index, UInt8 *page, UInt64 pageLength)
+{
+    const struct dyld_cache_slide_info3 *info = (const struct dyld_cache_slide_info3 *)context->slideInfo;
+
+    if (index >= info->page_starts_count)
+        return NO;
+
+    UInt16 start = info->page_starts[index];
+
+    if (start == DYLD_CACHE_SLIDE_V3_PAGE_ATTR_NO_REBASE)
+        return YES;
+
+    UInt64 offset = start;
+    UInt64 delta;
+
+    do {
+        if (offset + sizeof(UInt64) > pageLength)
+            return NO;
+
+        UInt64 raw = MTReadValue(page + offset, sizeof(UInt64));
+        UInt64 value;
+
+        // offsetToNextPointer is bits [51, 62), authenticated is bit 63
+        delta = ((raw >> 51) & 0x7FF) * 8;
+
+        if (raw >> 63) {
+            // offsetFromSharedCacheBase is the low 32 bits
+            value = (raw & 0xFFFFFFFF) + info->auth_value_add + context->slide;
+        } else {
+            // The top 8 bits of the pointer are stored at bit 43 of the 51 bit value.
+            UInt64 value51 = (raw & 0x0007FFFFFFFFFFFFULL);
+            UInt64 top8Bits = (value51 & 0x0007F80000000000ULL);
+            UInt64 bottom43Bits = (value51 & 0x000007FFFFFFFFFFULL);
+
+            value = (top8Bits << 13) | bottom43Bits;
+            value += context->slide;
+        }
+
+        MTWriteValue(page + offset, value, sizeof(UInt64));
+        offset += delta;
+    } while (delta);
+
+    return YES;
+}
+
+// Version 5: Newer arm64e caches. All pointers are 34 bit offsets from `value_add`
+static BOOL MTRebasePageV5(const MTSlideContext *context, NSUInteger index, UInt8 *page, UInt64 pageLength)
+{
+    const struct MTCacheSlideInfo5 *info = (const struct MTCacheSlideInfo5 *)context->slideInfo;
+
+    if (index >= info->page_starts_count)
+        return NO;
+
+    UInt16 start = info->page_starts[index];
+
+    if (start == kMTCacheSlideV5PageNoRebase)
+        return YES;
+
+    UInt64 offset = start;
+    UInt64 delta;
+
+    do {
+        if (offset + sizeof(UInt64) > pageLength)
+            return NO;
+
+        UInt64 raw = MTReadValue(page + offset, sizeof(UInt64));
+
+        // runtimeOffset is bits [0, 34), high8 is bits [34, 42), next is bits [52, 63), auth is bit 63
+        UInt64 value = (raw & 0x3FFFFFFFFULL) + info->value_add + context->slide;
+        delta = ((raw >> 52) & 0x7FF) * 8;
+
+        if (!(raw >> 63))
+            value |= ((raw >> 34) & 0xFF) << 56;
+
+        MTWriteValue(page + offset, value, sizeof(UInt64));
+        offset += delta;
+    } while (delta);
+
+    return YES;
+}
+
+// Make sure page `index` is rebased. Safe to call from any thread.
+static void MTSlideContextEnsurePage(MTSlideContext *context, NSUInteger index)
+{
+    _Atomic(UInt8) *state = &context->pageStates[index];
+
+    if (atomic_load_explicit(state, memory_order_acquire) == kMTPageStateRebased)
+        return;
+
+    UInt8 expected = kMTPageStateUntouched;
+
+    if (!atomic_compare_exchange_strong_explicit(state, &expected, kMTPageStateInProgress, memory_order_acquire, memory_order_acquire))
+    {
+        // Someone else is rebasing this page. It's only ever a page worth of work, so just wait.
+        while (atomic_load_explicit(state, memory_order_acquire) != kMTPageStateRebased)
+            sched_yield();
+
+        return;
+    }
+
+    UInt64 pageOffset = (UInt64)index * context->pageSize;
+    UInt64 pageLength = MIN((UInt64)context->pageSize, context->size - pageOffset);
+    UInt8 *page = context->destination + pageOffset;
+
+    memcpy(page, context->source + pageOffset, pageLength);
+
+    BOOL result;
+
+    switch (context->version)
+    {
+        case 2:  result = MTRebasePageV2(context, index, page, pageLength); break;
+        case 3:  result = MTRebasePageV3(context, index, page, pageLength); break;
+        case 5:  result = MTRebasePageV5(context, index, page, pageLength); break;
+        default: result = NO; break;
+    }
+
+    if (!result)
+        atomic_store(&context->malformed, true);
+
+    atomic_fetch_add(&context->rebasedPageCount, 1);
+    atomic_store_explicit(state, kMTPageStateRebased, memory_order_release);
+}
+
+#pragma mark - MTSharedCacheRebasedMapping
+
+@implementation MTSharedCacheRebasedMapping
+{
+    // Keeps the raw mapping and slide info alive
+    NSData *_file;
+
+    MTSlideContext _context;
+
+    UInt64 _mappedSize;
+    UInt64 _flags;
+}
+
+@synthesize address = _address;
+
+@dynamic size;
+@dynamic slide;
+@dynamic slideInfoVersion;
+@dynamic pageSize;
+@dynamic pageCount;
+@dynamic rebasedPageCount;
+
+@dynamic isAuthData;
+@dynamic isConstData;
+
+- (instancetype) initWithMapping:(const MTSharedCacheMapping *)mapping file:(NSData *)file slide:(UInt64)slide
+{
+    if (!mapping->slideInfoSize)
+        return nil;
+
+    // Every version starts with its version number.
+    if (mapping->slideInfoSize < sizeof(UInt32))
+    {
+        NSLog(@"Slide info for mapping at 0x%08llX is too small!", mapping->address);
+
+        return nil;
+    }
+
+    const UInt8 *slideInfo = (const UInt8 *)[file bytes] + mapping->slideInfoOffset;
+    UInt32 version = *(const UInt32 *)slideInfo;
+    UInt32 pageSize;
+
+    switch (version)
+    {
+        case 2: {
+            const struct dyld_cache_slide_info2 *info = (const struct dyld_cache_slide_info2 *)slideInfo;
+
+            if (mapping->slideInfoSize < sizeof(*info)
+             || info->page_starts_offset + (info->page_starts_count * sizeof(UInt16)) > mapping->slideInfoSize
+             || info->page_extras_offset + (info->page_extras_count * sizeof(UInt16)) > mapping->slideInfoSize)
+            {
+                NSLog(@"Slide info (v2) for mapping at 0x%08llX is truncated!", mapping->address);
+
+                return nil;
+            }
+
+            pageSize = info->page_size;
+        } break;
+        case 3: {
+            const struct dyld_cache_slide_info3 *info = (const struct dyld_cache_slide_info3 *)slideInfo;
+
+            if (mapping->slideInfoSize < sizeof(*info) || sizeof(*info) + (info->page_starts_count * sizeof(UInt16)) > mapping->slideInfoSize)
+            {
+                NSLog(@"Slide info (v3) for mapping at 0x%08llX is truncated!", mapping->address);
+
+                return nil;
+            }
+
+            pageSize = info->page_size;
+        } break;
+        case 5: {
+            const struct MTCacheSlideInfo5 *info = (const struct MTCacheSlideInfo5 *)slideInfo;
+
+            if (mapping->slideInfoSize < sizeof(*info) || sizeof(*info) + (info->page_starts_count * sizeof(UInt16)) > mapping->slideInfoSize)
+            {
+                NSLog(@"Slide info (v5) for mapping at 0x%08llX is truncated!", mapping->address);
+
+                return nil;
+            }
+
+            pageSize = info->page_size;
+        } break;
+        default: {
+            // Version 1 is ancient, and version 4 is only used for arm64_32.
+            NSLog(@"Unsupported slide info version %u for mapping at 0x%08llX!", version, mapping->address);
+
+            return nil;
+        }
+    }
+
+    if (!pageSize || (pageSize & (pageSize - 1)))
+    {
+        NSLog(@"Slide info for mapping at 0x%08llX has invalid page size 0x%X!", mapping->address, pageSize);
+
+        return nil;
+    }
+
+    self = [super init];
+
+    if (self)
+    {
+        self->_file = file;
+        self->_address = mapping->address;
+        self->_flags = mapping->flags;
+
+        self->_context.slideInfo = slideInfo;
+        self->_context.slideInfoSize = mapping->slideInfoSize;
+        self->_context.version = version;
+
+        self->_context.source = (const UInt8 *)[file bytes] + mapping->fileOffset;
+        self->_context.size = mapping->size;
+
+        self->_context.pageSize = pageSize;
+        self->_context.pageCount = (NSUInteger)((mapping->size + pageSize - 1) / pageSize);
+        self->_context.slide = slide;
+
+        // Anonymous memory isn't backed by anything until it's touched, so untouched pages cost nothing.
+        self->_mappedSize = (UInt64)self->_context.pageCount * pageSize;
+        void *destination = mmap(NULL, self->_mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+
+        if (destination == MAP_FAILED)
+        {
+            NSLog(@"Failed to allocate 0x%llX bytes for rebased mapping! (%s)", self->_mappedSize, strerror(errno));
+
+            return nil;
+        }
+
+        self->_context.destination = (UInt8 *)destination;
+        self->_context.pageStates = calloc(self->_context.pageCount, sizeof(_Atomic(UInt8)));
+
+        if (!self->_context.pageStates)
+        {
+            NSLog(@"Out of memory!");
+
+            return nil;
+        }
+
+        atomic_init(&self->_context.rebasedPageCount, 0);
+        atomic_init(&self->_context.malformed, false);
+    }
+
+    return self;
+}
+
+#pragma mark Property getters
+
+- (UInt64) size
+{
+    return self->_context.size;
+}
+
+- (UInt64) slide
+{
+    return self->_context.slide;
+}
+
+- (UInt32) slideInfoVersion
+{
+    return self->_context.version;
+}
+
+- (UInt32) pageSize
+{
+    return self->_context.pageSize;
+}
+
+- (NSUInteger) pageCount
+{
+    return self->_context.pageCount;
+}
+
+- (NSUInteger) rebasedPageCount
+{
+    return (NSUInteger)atomic_load(&self->_context.rebasedPageCount);
+}
+
+- (BOOL) isAuthData
+{
+    return !!(self->_flags & DYLD_CACHE_MAPPING_AUTH_DATA);
+}
+
+- (BOOL) isConstData
+{
+    return !!(self->_flags & DYLD_CACHE_MAPPING_CONST_DATA);
+}
+
+#pragma mark Rebasing
+
+- (const void *) pointerForAddress:(UInt64)address size:(UInt64)size
+{
+    if (address < self->_address || address - self->_address + size > self->_context.size)
+        return NULL;
+
+    UInt64 offset = address - self->_address;
+    NSUInteger first = (NSUInteger)(offset / self->_context.pageSize);
+    NSUInteger last = (NSUInteger)((offset + (size ? size - 1 : 0)) / self->_context.pageSize);
+
+    for (NSUInteger i = first; i <= last; i++)
+        MTSlideContextEnsurePage(&self->_context, i);
+
+    return self->_context.destination + offset;
+}
+
+- (BOOL) rebaseAllPages
+{
+    MTSlideContext *context = &self->_context;
+
+    // Pages are independent, but are small. Hand them out in batches to keep dispatch overhead down.
+    NSUInteger batchSize = 64;
+    NSUInteger batchCount = (context->pageCount + batchSize - 1) / batchSize;
+
+    dispatch_apply(batchCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t batch) {
+        NSUInteger end = MIN((batch + 1) * batchSize, context->pageCount);
+
+        for (NSUInteger i = batch * batchSize; i < end; i++)
+            MTSlideContextEnsurePage(context, i);
+    });
+
+    if (atomic_load(&context->malformed))
+    {
+        NSLog(@"Found malformed slide info in mapping at 0x%08llX!", self->_address);
+
+        return NO;
+    }
+
+    return YES;
+}
+
+- (void) dealloc
+{
+    if (self->_context.destination)
+        munmap(self->_context.destination, self->_mappedSize);
+
+    if (self->_context.pageStates)
+        free(self->_context.pageStates);
+}
+
+@end
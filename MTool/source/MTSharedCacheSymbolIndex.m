@@ -0,0 +1,703 @@
+#import <MTool/MTool.h>
+#import <MTool/MTSharedCacheSymbolIndex.h>
+
+#import <mach-o/loader.h>
+
+// For noting failed images across workers
+#import <stdatomic.h>
+
+#import "MTMachOPrivate.h"
+
+#define kMTSymbolIndexMagic         "MTSYMIDX"
+#define kMTSymbolIndexMagicSize     8
+
+// Export trie names can't be longer than this, and tries can't be deeper than this. Both are far past anything real.
+#define kMTSymbolIndexMaxName       4096
+#define kMTSymbolIndexMaxDepth      512
+
+// Give up building the perfect hash if a single bucket needs more displacements than this.
+#define kMTSymbolIndexMaxDisplacement   (1 << 24)
+
+// Everything in the file is naturally aligned, so it can be used straight from the mapping.
+typedef struct {
+    char magic[kMTSymbolIndexMagicSize];
+    UInt8 cacheUUID[16];
+
+    UInt32 symbolCount;
+    UInt32 imageCount;
+
+    UInt64 displacementsOffset;
+    UInt64 entriesOffset;
+    UInt64 stringsOffset;
+    UInt64 stringsSize;
+} MTSymbolIndexHeader;
+
+// Entries are stored in hash slot order.
+typedef struct {
+    UInt32 nameOffset;
+    UInt32 imageIndex;
+    UInt64 address;
+} MTSymbolIndexEntry;
+
+// 64 bit FNV-1a, seeded so that each displacement gives an independent hash.
+static UInt64 MTSymbolIndexHash(const char *name, UInt32 seed)
+{
+    UInt64 hash = 0xCBF29CE484222325ULL ^ ((UInt64)seed * 0x9E3779B97F4A7C15ULL);
+
+    for (; *name; name++)
+        hash = (hash ^ (UInt8)(*name)) * 0x100000001B3ULL;
+
+    return hash ^ (hash >> 32);
+}
+
+#pragma mark - Export collection
+
+// Exports from a single image. Each worker fills in exactly one of these, so there's nothing to lock.
+@interface MTSymbolIndexImageExports : NSObject
+{
+    @public
+
+    // NUL terminated names, back to back
+    NSMutableData *names;
+
+    // (name offset, address) pairs
+    NSMutableData *entries;
+}
+
+@end
+
+@implementation MTSymbolIndexImageExports
+
+- (instancetype) init
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->names = [[NSMutableData alloc] init];
+        self->entries = [[NSMutableData alloc] init];
+    }
+
+    return self;
+}
+
+@end
+
+typedef struct {
+    UInt32 nameOffset;
+    UInt64 address;
+} MTSymbolIndexImageEntry;
+
+typedef struct {
+    const UInt8 *trie;
+    const UInt8 *end;
+    UInt64 imageAddress;
+
+    // Every node in a well formed trie is reached exactly once, and each takes at least 2 bytes.
+    // Children that share nodes can make the walk exponential, so stop once more nodes are visited than could exist.
+    UInt64 nodeBudget;
+
+    char name[kMTSymbolIndexMaxName];
+    __unsafe_unretained MTSymbolIndexImageExports *exports;
+} MTSymbolIndexTrieWalk;
+
+static BOOL MTSymbolIndexWalkNode(MTSymbolIndexTrieWalk *walk, UInt64 node, size_t nameLength, UInt32 depth)
+{
+    const UInt8 *p = walk->trie + node;
+    UInt64 terminalSize;
+
+    if (depth > kMTSymbolIndexMaxDepth || !walk->nodeBudget || p >= walk->end || !MTReadULEB128(&p, walk->end, &terminalSize))
+        return NO;
+
+    walk->nodeBudget--;
+
+    const UInt8 *children = p + terminalSize;
+
+    if (terminalSize)
+    {
+        UInt64 flags;
+        UInt64 offset;
+
+        if (!MTReadULEB128(&p, walk->end, &flags))
+            return NO;
+
+        // Re-exports don't have an address; the symbol is found in the image they point to.
+        if (!(flags & EXPORT_SYMBOL_FLAGS_REEXPORT))
+        {
+            if (!MTReadULEB128(&p, walk->end, &offset))
+                return NO;
+
+            MTSymbolIndexImageEntry entry = {
+                .nameOffset = (UInt32)[walk->exports->names length],
+                .address = ((flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE) ? offset : walk->imageAddress + offset
+            };
+
+            [walk->exports->names appendBytes:walk->name length:nameLength + 1];
+            [walk->exports->entries appendBytes:&entry length:sizeof(MTSymbolIndexImageEntry)];
+        }
+    }
+
+    p = children;
+
+    if (p >= walk->end)
+        return NO;
+
+    UInt8 childCount = *p++;
+
+    for (UInt8 i = 0; i < childCount; i++)
+    {
+        size_t edgeLength = strnlen((const char *)p, walk->end - p);
+        UInt64 child;
+
+        if (p + edgeLength >= walk->end || nameLength + edgeLength >= kMTSymbolIndexMaxName)
+            return NO;
+
+        memcpy(walk->name + nameLength, p, edgeLength + 1);
+        p += edgeLength + 1;
+
+        if (!MTReadULEB128(&p, walk->end, &child) || child >= (UInt64)(walk->end - walk->trie))
+            return NO;
+
+        if (!MTSymbolIndexWalkNode(walk, child, nameLength + edgeLength, depth + 1))
+            return NO;
+    }
+
+    return YES;
+}
+
+// Offsets and sizes come from the file, so check them without letting the sum overflow.
+static inline BOOL MTSymbolIndexRangeFits(UInt64 offset, UInt64 size, UInt64 length)
+{
+    return (offset <= length && size <= length - offset);
+}
+
+@interface MTSharedCacheSymbolIndex (Private)
+
+- (instancetype) initWithData:(NSData *)data cache:(MTSharedCache *)cache;
+
+@end
+
+@implementation MTSharedCacheSymbolIndex
+{
+    // Either the mapped index file, or the buffer we just built.
+    NSData *_data;
+
+    __weak MTSharedCache *_cache;
+
+    const MTSymbolIndexHeader *_header;
+    const SInt32 *_displacements;
+    const MTSymbolIndexEntry *_entries;
+    const char *_strings;
+}
+
+@dynamic symbolCount;
+
+#pragma mark Building an index
+
++ (BOOL) collectExportsForImage:(MTSharedCacheImage *)cacheImage cache:(MTSharedCache *)cache into:(MTSymbolIndexImageExports *)exports
+{
+    MTMachO *image = [cacheImage image];
+
+    if (!image)
+        return NO;
+
+    const MTImageDecoder *decoder = [image decoder];
+    MTSegmentInfo *linkedit = nil;
+    UInt32 trieOffset = 0;
+    UInt32 trieSize = 0;
+
+    for (MTSegmentInfo *segment in [image segments])
+    {
+        if ([[segment name] isEqualToString:@SEG_LINKEDIT])
+            linkedit = segment;
+    }
+
+    for (MTLoadCommand *command in [image allLoadCommands])
+    {
+        const UInt8 *raw = [command rawCommand];
+
+        switch ([command type])
+        {
+            case LC_DYLD_INFO:
+            case LC_DYLD_INFO_ONLY: {
+                if ([command range].length < sizeof(struct dyld_info_command))
+                    break;
+
+                trieOffset = decoder->read32(raw + offsetof(struct dyld_info_command, export_off));
+                trieSize = decoder->read32(raw + offsetof(struct dyld_info_command, export_size));
+            } break;
+            case LC_DYLD_EXPORTS_TRIE: {
+                if ([command range].length < sizeof(struct linkedit_data_command))
+                    break;
+
+                trieOffset = decoder->read32(raw + offsetof(struct linkedit_data_command, dataoff));
+                trieSize = decoder->read32(raw + offsetof(struct linkedit_data_command, datasize));
+            } break;
+        }
+    }
+
+    // Not exporting anything is fine.
+    if (!trieSize)
+        return YES;
+
+    // Linkedit offsets in cached images are relative to the shared __LINKEDIT, so translate them to an address.
+    if (!linkedit || trieOffset < [linkedit fileOffset])
+    {
+        NSLog(@"Export trie for image '%@' is outside of __LINKEDIT!", [cacheImage path]);
+
+        return NO;
+    }
+
+    const UInt8 *trie = [cache pointerForAddress:([linkedit vmAddress] + (trieOffset - [linkedit fileOffset])) size:trieSize];
+
+    if (!trie)
+    {
+        NSLog(@"Export trie for image '%@' is not mapped in cache!", [cacheImage path]);
+
+        return NO;
+    }
+
+    MTSymbolIndexTrieWalk *walk = malloc(sizeof(MTSymbolIndexTrieWalk));
+
+    if (!walk)
+        return NO;
+
+    walk->trie = trie;
+    walk->end = trie + trieSize;
+    walk->imageAddress = [cacheImage address];
+    walk->nodeBudget = (trieSize / 2) + 1;
+    walk->exports = exports;
+    walk->name[0] = 0;
+
+    BOOL result = MTSymbolIndexWalkNode(walk, 0, 0, 0);
+    free(walk);
+
+    if (!result)
+        NSLog(@"Export trie for image '%@' is malformed!", [cacheImage path]);
+
+    return result;
+}
+
+// Build a minimal perfect hash over `count` names (hash and displace). `slots` gets the key index for each slot.
+// Returns NO if no displacement could be found for some bucket, which is astronomically unlikely.
++ (BOOL) buildHashForNames:(const char *const *)names count:(UInt32)count displacements:(SInt32 *)displacements slots:(UInt32 *)slots
+{
+    // One bucket per key. Most buckets end up with 0-2 keys.
+    UInt32 *bucketCounts = calloc(count + 1, sizeof(UInt32));
+    UInt32 *bucketStarts = calloc(count + 1, sizeof(UInt32));
+    UInt32 *members = calloc(count, sizeof(UInt32));
+    UInt32 *order = calloc(count, sizeof(UInt32));
+    UInt8 *occupied = calloc(count, sizeof(UInt8));
+    UInt32 *trial = NULL;
+    BOOL result = NO;
+
+    if (!bucketCounts || !bucketStarts || !members || !order || !occupied)
+        goto done;
+
+    UInt32 maxBucketSize = 0;
+
+    for (UInt32 i = 0; i < count; i++)
+    {
+        UInt32 bucket = (UInt32)(MTSymbolIndexHash(names[i], 0) % count);
+
+        if (++bucketCounts[bucket] > maxBucketSize)
+            maxBucketSize = bucketCounts[bucket];
+    }
+
+    for (UInt32 i = 1; i <= count; i++)
+        bucketStarts[i] = bucketStarts[i - 1] + bucketCounts[i - 1];
+
+    // Counting sort keys by bucket...
+    memset(bucketCounts, 0, count * sizeof(UInt32));
+
+    for (UInt32 i = 0; i < count; i++)
+    {
+        UInt32 bucket = (UInt32)(MTSymbolIndexHash(names[i], 0) % count);
+
+        members[bucketStarts[bucket] + bucketCounts[bucket]++] = i;
+    }
+
+    // ... and then buckets by size, largest first, since those are the hardest to place.
+    UInt32 position = 0;
+
+    for (UInt32 size = maxBucketSize; size > 0; size--)
+    {
+        for (UInt32 bucket = 0; bucket < count; bucket++)
+        {
+            if (bucketCounts[bucket] == size)
+                order[position++] = bucket;
+        }
+    }
+
+    trial = calloc(maxBucketSize ? maxBucketSize : 1, sizeof(UInt32));
+
+    if (!trial)
+        goto done;
+
+    UInt32 freeSlot = 0;
+
+    for (UInt32 i = 0; i < position; i++)
+    {
+        UInt32 bucket = order[i];
+        UInt32 size = bucketCounts[bucket];
+        const UInt32 *keys = members + bucketStarts[bucket];
+
+        // Single keys don't need a hash at all; they just take the next free slot.
+        if (size == 1)
+        {
+            while (occupied[freeSlot])
+                freeSlot++;
+
+            occupied[freeSlot] = 1;
+            slots[freeSlot] = keys[0];
+            displacements[bucket] = -(SInt32)freeSlot - 1;
+
+            continue;
+        }
+
+        UInt32 displacement = 1;
+
+        for (;; displacement++)
+        {
+            if (displacement > kMTSymbolIndexMaxDisplacement)
+                goto done;
+
+            BOOL fits = YES;
+
+            for (UInt32 k = 0; k < size && fits; k++)
+            {
+                trial[k] = (UInt32)(MTSymbolIndexHash(names[keys[k]], displacement) % count);
+
+                if (occupied[trial[k]])
+                    fits = NO;
+
+                for (UInt32 j = 0; j < k && fits; j++)
+                {
+                    if (trial[j] == trial[k])
+                        fits = NO;
+                }
+            }
+
+            if (fits)
+                break;
+        }
+
+        for (UInt32 k = 0; k < size; k++)
+        {
+            occupied[trial[k]] = 1;
+            slots[trial[k]] = keys[k];
+        }
+
+        displacements[bucket] = (SInt32)displacement;
+    }
+
+    result = YES;
+
+done:
+    free(bucketCounts);
+    free(bucketStarts);
+    free(members);
+    free(order);
+    free(occupied);
+    free(trial);
+
+    return result;
+}
+
++ (instancetype) buildForCache:(MTSharedCache *)cache
+{
+    NSArray<MTSharedCacheImage *> *images = [cache images];
+    NSMutableArray<MTSymbolIndexImageExports *> *perImage = [[NSMutableArray alloc] initWithCapacity:[images count]];
+
+    for (NSUInteger i = 0; i < [images count]; i++)
+        [perImage addObject:[[MTSymbolIndexImageExports alloc] init]];
+
+    atomic_bool failed = false;
+    atomic_bool *failure = &failed;
+
+    // Tries are independent, so walk them all at once.
+    dispatch_apply([images count], dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t i) {
+        @autoreleasepool
+        {
+            if (![self collectExportsForImage:[images objectAtIndex:i] cache:cache into:[perImage objectAtIndex:i]])
+                atomic_store(failure, true);
+        }
+    });
+
+    // An index missing some image's exports would give wrong answers, and would be saved and reused as if it were complete.
+    if (atomic_load(&failed))
+    {
+        NSLog(@"Failed to collect exports for every image in cache!");
+
+        return nil;
+    }
+
+    NSUInteger total = 0;
+
+    for (MTSymbolIndexImageExports *exports in perImage)
+        total += [exports->entries length] / sizeof(MTSymbolIndexImageEntry);
+
+    if (total > UINT32_MAX / 2)
+    {
+        NSLog(@"Too many exports in cache (%lu)!", (unsigned long)total);
+
+        return nil;
+    }
+
+    // Drop duplicate names, keeping the first in cache order. This is a plain open addressing set.
+    NSUInteger tableSize = 16;
+
+    while (tableSize < total * 2)
+        tableSize <<= 1;
+
+    UInt32 *table = calloc(tableSize, sizeof(UInt32));
+    const char **names = calloc(total ? total : 1, sizeof(const char *));
+    MTSymbolIndexEntry *entries = calloc(total ? total : 1, sizeof(MTSymbolIndexEntry));
+    UInt32 count = 0;
+
+    if (!table || !names || !entries)
+    {
+        NSLog(@"Out of memory!");
+
+        free(table);
+        free(names);
+        free(entries);
+
+        return nil;
+    }
+
+    for (NSUInteger image = 0; image < [perImage count]; image++)
+    {
+        MTSymbolIndexImageExports *exports = [perImage objectAtIndex:image];
+        const MTSymbolIndexImageEntry *imageEntries = [exports->entries bytes];
+        const char *imageNames = [exports->names bytes];
+        NSUInteger imageCount = [exports->entries length] / sizeof(MTSymbolIndexImageEntry);
+
+        for (NSUInteger i = 0; i < imageCount; i++)
+        {
+            const char *name = imageNames + imageEntries[i].nameOffset;
+            NSUInteger slot = MTSymbolIndexHash(name, 0) & (tableSize - 1);
+            BOOL duplicate = NO;
+
+            // Slots hold (index + 1), so 0 means empty.
+            while (table[slot])
+            {
+                if (!strcmp(names[table[slot] - 1], name))
+                {
+                    duplicate = YES;
+
+                    break;
+                }
+
+                slot = (slot + 1) & (tableSize - 1);
+            }
+
+            if (duplicate)
+                continue;
+
+            names[count] = name;
+            entries[count].imageIndex = (UInt32)image;
+            entries[count].address = imageEntries[i].address;
+            table[slot] = ++count;
+        }
+    }
+
+    free(table);
+
+    // Lay out the file: header, displacements, entries (in slot order), strings.
+    UInt64 displacementsOffset = sizeof(MTSymbolIndexHeader);
+    UInt64 entriesOffset = (displacementsOffset + ((UInt64)count * sizeof(SInt32)) + 7) & ~7ULL;
+    UInt64 stringsOffset = entriesOffset + ((UInt64)count * sizeof(MTSymbolIndexEntry));
+
+    NSMutableData *data = [[NSMutableData alloc] initWithLength:(NSUInteger)stringsOffset];
+    UInt32 *slots = calloc(count ? count : 1, sizeof(UInt32));
+
+    if (!data || !slots || ![self buildHashForNames:names count:count displacements:(SInt32 *)((UInt8 *)[data mutableBytes] + displacementsOffset) slots:slots])
+    {
+        NSLog(@"Failed to build symbol hash for cache!");
+
+        free(names);
+        free(entries);
+        free(slots);
+
+        return nil;
+    }
+
+    MTSymbolIndexEntry *fileEntries = (MTSymbolIndexEntry *)((UInt8 *)[data mutableBytes] + entriesOffset);
+
+    for (UInt32 slot = 0; slot < count; slot++)
+    {
+        UInt32 key = slots[slot];
+
+        fileEntries[slot] = entries[key];
+        fileEntries[slot].nameOffset = (UInt32)([data length] - stringsOffset);
+
+        [data appendBytes:names[key] length:strlen(names[key]) + 1];
+
+        // Appending may move the buffer.
+        fileEntries = (MTSymbolIndexEntry *)((UInt8 *)[data mutableBytes] + entriesOffset);
+    }
+
+    free(names);
+    free(entries);
+    free(slots);
+
+    MTSymbolIndexHeader *header = (MTSymbolIndexHeader *)[data mutableBytes];
+    memcpy(header->magic, kMTSymbolIndexMagic, kMTSymbolIndexMagicSize);
+    [[cache uuid] getUUIDBytes:header->cacheUUID];
+
+    header->symbolCount = count;
+    header->imageCount = (UInt32)[images count];
+    header->displacementsOffset = displacementsOffset;
+    header->entriesOffset = entriesOffset;
+    header->stringsOffset = stringsOffset;
+    header->stringsSize = [data length] - stringsOffset;
+
+    return [[MTSharedCacheSymbolIndex alloc] initWithData:data cache:cache];
+}
+
+#pragma mark Loading and saving
+
+- (instancetype) initWithData:(NSData *)data cache:(MTSharedCache *)cache
+{
+    self = [super init];
+
+    if (self)
+    {
+        if ([data length] < sizeof(MTSymbolIndexHeader))
+            return nil;
+
+        const MTSymbolIndexHeader *header = [data bytes];
+        uuid_t uuid;
+
+        [[cache uuid] getUUIDBytes:uuid];
+
+        if (memcmp(header->magic, kMTSymbolIndexMagic, kMTSymbolIndexMagicSize) || memcmp(header->cacheUUID, uuid, sizeof(uuid_t)))
+            return nil;
+
+        if (header->imageCount != [[cache images] count])
+            return nil;
+
+        // Everything needs to be in the file before we trust any of it.
+        if (!MTSymbolIndexRangeFits(header->displacementsOffset, (UInt64)header->symbolCount * sizeof(SInt32), [data length]) ||
+            !MTSymbolIndexRangeFits(header->entriesOffset, (UInt64)header->symbolCount * sizeof(MTSymbolIndexEntry), [data length]) ||
+            !MTSymbolIndexRangeFits(header->stringsOffset, header->stringsSize, [data length]) ||
+            (header->displacementsOffset % sizeof(SInt32)) || (header->entriesOffset % sizeof(UInt64)) ||
+            (header->stringsSize && ((const char *)[data bytes])[header->stringsOffset + header->stringsSize - 1]))
+        {
+            return nil;
+        }
+
+        self->_data = data;
+        self->_cache = cache;
+
+        self->_header = header;
+        self->_displacements = (const SInt32 *)((const UInt8 *)[data bytes] + header->displacementsOffset);
+        self->_entries = (const MTSymbolIndexEntry *)((const UInt8 *)[data bytes] + header->entriesOffset);
+        self->_strings = (const char *)[data bytes] + header->stringsOffset;
+    }
+
+    return self;
+}
+
++ (instancetype) loadFromURL:(NSURL *)url forCache:(MTSharedCache *)cache
+{
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedAlways error:nil];
+
+    if (!data)
+        return nil;
+
+    MTSharedCacheSymbolIndex *index = [[MTSharedCacheSymbolIndex alloc] initWithData:data cache:cache];
+
+    if (!index)
+        NSLog(@"Symbol index at URL '%@' is malformed or was built for another cache!", url);
+
+    return index;
+}
+
++ (NSURL *) defaultURLForCache:(MTSharedCache *)cache
+{
+    if (![cache url])
+        return nil;
+
+    return [NSURL fileURLWithPath:[[[cache url] path] stringByAppendingString:@".symindex"]];
+}
+
++ (instancetype) indexForCache:(MTSharedCache *)cache
+{
+    NSURL *url = [self defaultURLForCache:cache];
+    MTSharedCacheSymbolIndex *index;
+
+    if (url && [[NSFileManager defaultManager] fileExistsAtPath:[url path]] && (index = [self loadFromURL:url forCache:cache]))
+        return index;
+
+    index = [self buildForCache:cache];
+
+    if (index && url && ![index writeToURL:url])
+        NSLog(@"Couldn't save symbol index to URL '%@'. It will be rebuilt next time.", url);
+
+    return index;
+}
+
+- (BOOL) writeToURL:(NSURL *)url
+{
+    return [self->_data writeToURL:url options:NSDataWritingAtomic error:nil];
+}
+
+#pragma mark Lookups
+
+- (NSUInteger) symbolCount
+{
+    return self->_header->symbolCount;
+}
+
+- (BOOL) lookupSymbolName:(const char *)symbol imageIndex:(NSUInteger *)imageIndex address:(UInt64 *)address
+{
+    UInt32 count = self->_header->symbolCount;
+
+    if (!count)
+        return NO;
+
+    SInt32 displacement = self->_displacements[MTSymbolIndexHash(symbol, 0) % count];
+    UInt32 slot;
+
+    if (displacement < 0) {
+        slot = (UInt32)(-(displacement + 1));
+    } else if (displacement > 0) {
+        slot = (UInt32)(MTSymbolIndexHash(symbol, (UInt32)displacement) % count);
+    } else {
+        // Empty bucket
+        return NO;
+    }
+
+    if (slot >= count)
+        return NO;
+
+    // A perfect hash maps names not in the set to arbitrary slots, so check the name.
+    const MTSymbolIndexEntry *entry = &self->_entries[slot];
+
+    if (entry->nameOffset >= self->_header->stringsSize || strcmp(self->_strings + entry->nameOffset, symbol))
+        return NO;
+
+    if (imageIndex)
+        (*imageIndex) = entry->imageIndex;
+
+    if (address)
+        (*address) = entry->address;
+
+    return YES;
+}
+
+- (MTSharedCacheImage *) imageExportingSymbol:(NSString *)symbol address:(UInt64 *)address
+{
+    NSUInteger imageIndex;
+
+    if (![self lookupSymbolName:[symbol UTF8String] imageIndex:&imageIndex address:address])
+        return nil;
+
+    NSArray<MTSharedCacheImage *> *images = [self->_cache images];
+
+    return (imageIndex < [images count]) ? [images objectAtIndex:imageIndex] : nil;
+}
+
+@end
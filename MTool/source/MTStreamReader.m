@@ -0,0 +1,496 @@
+#import <MTool/MTool.h>
+#import <MTool/MTStreamReader.h>
+
+// For struct fat_header, struct fat_arch, etc.
+#import <mach-o/fat.h>
+
+// For MTImageDecoderForMagic and MTFatArchDecoder
+#import "MTImageDecoder.h"
+
+// Reads from the input are done in chunks of this size.
+#define kMTStreamChunkSize          (1024 * 1024)
+
+// Nothing legitimate has more FAT entries than this. It keeps a corrupt header from making us buffer gigabytes.
+#define kMTStreamMaxFatEntries      1024
+
+// Likewise for the size of load commands we buffer for a slice.
+#define kMTStreamMaxCommandsSize    (16 * 1024 * 1024)
+
+#pragma mark - MTStreamSlice
+
+@interface MTStreamSlice (Private)
+
+- (instancetype) initWithIndex:(NSUInteger)index entry:(const struct fat_arch_64 *)entry;
+
+@end
+
+@implementation MTStreamSlice
+{
+    // Where this slice ends in the stream. This is UINT64_MAX for thin images until the stream ends.
+    UInt64 _end;
+
+    // Header and load commands, collected as they pass.
+    NSMutableData *_headers;
+    const MTImageDecoder *_decoder;
+    UInt64 _headersSize;
+
+    NSOutputStream *_output;
+
+    BOOL _started;
+    BOOL _reported;
+    BOOL _finished;
+
+    // Set if the headers were bad or the slice ended before they did.
+    BOOL _malformed;
+}
+
+@synthesize index = _index;
+@synthesize type = _type;
+@synthesize subtype = _subtype;
+@synthesize offset = _offset;
+@synthesize size = _size;
+@synthesize alignment = _alignment;
+@synthesize image = _image;
+
+- (instancetype) initWithIndex:(NSUInteger)index entry:(const struct fat_arch_64 *)entry
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->_index = index;
+        self->_headers = [[NSMutableData alloc] init];
+
+        // The magic is always needed before we know how much more to collect.
+        self->_headersSize = sizeof(UInt32);
+
+        if (entry) {
+            self->_type = entry->cputype;
+            self->_subtype = entry->cpusubtype;
+            self->_offset = entry->offset;
+            self->_size = entry->size;
+            self->_alignment = entry->align;
+
+            self->_end = entry->offset + entry->size;
+        } else {
+            self->_end = UINT64_MAX;
+        }
+    }
+
+    return self;
+}
+
+// Work out how many header bytes we need from what we have so far. Returns NO once nothing more is needed.
+- (BOOL) updateHeadersSize
+{
+    const UInt8 *headers = [self->_headers bytes];
+    NSUInteger length = [self->_headers length];
+
+    if (length < self->_headersSize)
+        return YES;
+
+    if (!self->_decoder)
+    {
+        self->_decoder = MTImageDecoderForMagic(*(const UInt32 *)headers);
+
+        // Not a Mach-O image. We're done.
+        if (!self->_decoder)
+            return NO;
+
+        self->_headersSize = self->_decoder->headerSize;
+        return (length < self->_headersSize) ? YES : [self updateHeadersSize];
+    }
+
+    if (self->_headersSize == self->_decoder->headerSize)
+    {
+        struct mach_header_64 header;
+        self->_decoder->readHeader(headers, &header);
+
+        if (header.sizeofcmds > kMTStreamMaxCommandsSize)
+        {
+            NSLog(@"Slice %lu has implausibly large load commands (%u bytes)!", (unsigned long)self->_index, header.sizeofcmds);
+
+            self->_malformed = YES;
+            return NO;
+        }
+
+        // Thin images only get their type from the header.
+        if (self->_end == UINT64_MAX)
+        {
+            self->_type = header.cputype;
+            self->_subtype = header.cpusubtype;
+        }
+
+        self->_headersSize += header.sizeofcmds;
+
+        return (length < self->_headersSize);
+    }
+
+    return NO;
+}
+
+- (void) reportWithHandler:(void (^)(MTStreamSlice *))handler
+{
+    if (self->_reported)
+        return;
+
+    self->_reported = YES;
+
+    // A Mach-O slice reported before all its headers arrived was cut short.
+    if (self->_decoder && [self->_headers length] < self->_headersSize)
+        self->_malformed = YES;
+
+    if (self->_decoder && !self->_malformed)
+        self->_image = [MTMachO loadFromData:[self->_headers copy]];
+
+    // Headers are only buffered until they've been parsed.
+    self->_headers = nil;
+
+    if (handler)
+        handler(self);
+}
+
+- (BOOL) writeBytes:(const UInt8 *)bytes length:(NSUInteger)length
+{
+    while (length)
+    {
+        NSInteger written = [self->_output write:bytes maxLength:length];
+
+        if (written <= 0)
+        {
+            NSLog(@"Failed to write slice %lu! (%@)", (unsigned long)self->_index, [self->_output streamError]);
+
+            return NO;
+        }
+
+        bytes += written;
+        length -= written;
+    }
+
+    return YES;
+}
+
+- (void) startWithReader:(MTStreamReader *)reader
+{
+    if (self->_started)
+        return;
+
+    self->_started = YES;
+
+    if ([reader outputForSlice])
+    {
+        self->_output = [reader outputForSlice](self);
+
+        if ([self->_output streamStatus] == NSStreamStatusNotOpen)
+            [self->_output open];
+    }
+}
+
+// Handle the part of [position, position + length) that falls in this slice.
+- (BOOL) consumeBytes:(const UInt8 *)bytes length:(NSUInteger)length at:(UInt64)position reader:(MTStreamReader *)reader
+{
+    if (self->_finished)
+        return YES;
+
+    UInt64 start = MAX(position, self->_offset);
+    UInt64 end = MIN(position + length, self->_end);
+
+    if (start >= end)
+    {
+        // Empty slices have no bytes to wait for. They're done as soon as the stream gets to them.
+        if (self->_offset == self->_end && position + length >= self->_offset)
+        {
+            [self startWithReader:reader];
+            [self finishWithReader:reader];
+        }
+
+        return YES;
+    }
+
+    const UInt8 *data = bytes + (start - position);
+    NSUInteger count = (NSUInteger)(end - start);
+
+    [self startWithReader:reader];
+
+    if (self->_output && ![self writeBytes:data length:count])
+        return NO;
+
+    if (!self->_reported)
+    {
+        // Slices only ever see their bytes in order, so this is just an append.
+        while (count && [self->_headers length] < self->_headersSize)
+        {
+            NSUInteger take = (NSUInteger)MIN((UInt64)count, self->_headersSize - [self->_headers length]);
+
+            [self->_headers appendBytes:data length:take];
+            data += take;
+            count -= take;
+
+            if (![self updateHeadersSize])
+            {
+                [self reportWithHandler:[reader sliceHandler]];
+
+                break;
+            }
+        }
+    }
+
+    if (end == self->_end)
+        [self finishWithReader:reader];
+
+    return YES;
+}
+
+- (void) finishWithReader:(MTStreamReader *)reader
+{
+    if (self->_finished)
+        return;
+
+    self->_finished = YES;
+
+    [self reportWithHandler:[reader sliceHandler]];
+
+    [self->_output close];
+    self->_output = nil;
+}
+
+// Thin images only find out how large they are here.
+- (void) finishAt:(UInt64)position reader:(MTStreamReader *)reader
+{
+    if (self->_end == UINT64_MAX)
+    {
+        self->_size = position - self->_offset;
+        self->_end = position;
+    }
+
+    [self finishWithReader:reader];
+}
+
+- (BOOL) isFinished
+{
+    return self->_finished;
+}
+
+- (BOOL) isMalformed
+{
+    return self->_malformed;
+}
+
+@end
+
+#pragma mark - MTStreamReader
+
+@implementation MTStreamReader
+{
+    NSInputStream *_stream;
+
+    NSMutableArray<MTStreamSlice *> *_slices;
+
+    // Bytes read so far
+    UInt64 _position;
+}
+
+@synthesize sliceHandler = _sliceHandler;
+@synthesize outputForSlice = _outputForSlice;
+
+@synthesize isFat = _isFat;
+
+@dynamic slices;
+
+- (instancetype) initWithInputStream:(NSInputStream *)stream
+{
+    self = [super init];
+
+    if (self)
+    {
+        self->_stream = stream;
+        self->_slices = [[NSMutableArray alloc] init];
+    }
+
+    return self;
+}
+
++ (instancetype) readerForStandardInput
+{
+    return [[MTStreamReader alloc] initWithInputStream:[NSInputStream inputStreamWithFileAtPath:@"/dev/stdin"]];
+}
+
+- (NSArray<MTStreamSlice *> *) slices
+{
+    return [self->_slices copy];
+}
+
+// Pipes hand back whatever they have, so keep reading until we get everything asked for (or the stream ends).
+- (BOOL) readExactly:(NSUInteger)length into:(NSMutableData *)data
+{
+    NSUInteger start = [data length];
+    [data setLength:start + length];
+
+    UInt8 *buffer = (UInt8 *)[data mutableBytes] + start;
+    NSUInteger offset = 0;
+
+    while (offset < length)
+    {
+        NSInteger bytesRead = [self->_stream read:buffer + offset maxLength:length - offset];
+
+        if (bytesRead <= 0)
+        {
+            if (bytesRead)
+                NSLog(@"Failed to read from stream! (%@)", [self->_stream streamError]);
+
+            return NO;
+        }
+
+        offset += bytesRead;
+    }
+
+    self->_position += length;
+    return YES;
+}
+
+// Read the FAT header and entry table. These are kept in `prefix` to be replayed once the slices exist.
+- (BOOL) readFatEntriesWithPrefix:(NSMutableData *)prefix
+{
+    if (![self readExactly:(sizeof(struct fat_header) - sizeof(UInt32)) into:prefix])
+    {
+        NSLog(@"Stream is too short for FAT header!");
+
+        return NO;
+    }
+
+    const struct fat_header *header = [prefix bytes];
+    BOOL is64bit = (MTSwapToHostEndian(header->magic) == FAT_MAGIC_64);
+    UInt32 count = MTSwapToHostEndian(header->nfat_arch);
+
+    if (count > kMTStreamMaxFatEntries)
+    {
+        NSLog(@"FAT header claims %u entries!", count);
+
+        return NO;
+    }
+
+    NSUInteger entrySize = is64bit ? sizeof(struct fat_arch_64) : sizeof(struct fat_arch);
+
+    if (![self readExactly:(count * entrySize) into:prefix])
+    {
+        NSLog(@"Stream is too short for FAT entries!");
+
+        return NO;
+    }
+
+    MTFatArchDecoder decode = is64bit ? MTFatArchDecode64 : MTFatArchDecode32;
+    const UInt8 *entries = (const UInt8 *)[prefix bytes] + sizeof(struct fat_header);
+
+    for (UInt32 i = 0; i < count; i++)
+    {
+        struct fat_arch_64 entry;
+        decode(entries + (i * entrySize), &entry);
+
+        if (entry.offset + entry.size < entry.offset)
+        {
+            NSLog(@"FAT entry %u wraps around!", i);
+
+            return NO;
+        }
+
+        [self->_slices addObject:[[MTStreamSlice alloc] initWithIndex:i entry:&entry]];
+    }
+
+    return YES;
+}
+
+- (BOOL) consumeBytes:(const UInt8 *)bytes length:(NSUInteger)length at:(UInt64)position
+{
+    for (MTStreamSlice *slice in self->_slices)
+    {
+        if (![slice consumeBytes:bytes length:length at:position reader:self])
+            return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL) read
+{
+    if ([self->_stream streamStatus] == NSStreamStatusNotOpen)
+        [self->_stream open];
+
+    NSMutableData *prefix = [[NSMutableData alloc] init];
+
+    if (![self readExactly:sizeof(UInt32) into:prefix])
+    {
+        NSLog(@"Stream is too short for any header!");
+
+        return NO;
+    }
+
+    UInt32 magic = MTSwapToHostEndian(*(const UInt32 *)[prefix bytes]);
+
+    if (magic == FAT_MAGIC || magic == FAT_MAGIC_64) {
+        self->_isFat = YES;
+
+        if (![self readFatEntriesWithPrefix:prefix])
+            return NO;
+    } else {
+        // Thin slices figure out their type from the header.
+        [self->_slices addObject:[[MTStreamSlice alloc] initWithIndex:0 entry:NULL]];
+    }
+
+    // Anything that starts before here has already gone by, so replay it from what we kept.
+    if (![self consumeBytes:[prefix bytes] length:[prefix length] at:0])
+        return NO;
+
+    UInt8 *buffer = malloc(kMTStreamChunkSize);
+    BOOL result = YES;
+
+    if (!buffer)
+    {
+        NSLog(@"Out of memory!");
+
+        return NO;
+    }
+
+    while (result)
+    {
+        NSInteger bytesRead = [self->_stream read:buffer maxLength:kMTStreamChunkSize];
+
+        if (bytesRead < 0)
+        {
+            NSLog(@"Failed to read from stream! (%@)", [self->_stream streamError]);
+
+            result = NO;
+            break;
+        }
+
+        if (!bytesRead)
+            break;
+
+        result = [self consumeBytes:buffer length:bytesRead at:self->_position];
+        self->_position += bytesRead;
+    }
+
+    free(buffer);
+
+    for (MTStreamSlice *slice in self->_slices)
+    {
+        if (!self->_isFat) {
+            [slice finishAt:self->_position reader:self];
+        } else if (![slice isFinished]) {
+            NSLog(@"Stream ended before the end of slice %lu!", (unsigned long)[slice index]);
+
+            [slice finishWithReader:self];
+            result = NO;
+        }
+
+        if ([slice isMalformed])
+        {
+            NSLog(@"Slice %lu has truncated or malformed headers!", (unsigned long)[slice index]);
+
+            result = NO;
+        }
+    }
+
+    return result;
+}
+
+@end
@@ -130,6 +130,67 @@ NSString *MTMachinePairToArchName(MTMachineType type, MTMachineSubtype _subtype)
     return [NSString stringWithFormat:@"(cputype (%d) cpusubtype (%d))", type, subtype];
 }
 
+bool MTMachinePairFromArchName(NSString *name, MTMachineType *type, MTMachineSubtype *subtype)
+{
+    // Every pair MTMachinePairToArchName() has a name for. Searching this keeps the two functions in sync.
+    static const struct { MTMachineType type; MTMachineSubtype subtype; } pairs[] = {
+        { kMTMachineTypeX86_64,     CPU_SUBTYPE_X86_64_ALL  },
+        { kMTMachineTypeX86_64,     CPU_SUBTYPE_X86_64_H    },
+        { kMTMachineTypeAArch64,    CPU_SUBTYPE_ARM64_ALL   },
+        { kMTMachineTypeAArch64,    CPU_SUBTYPE_ARM64_V8    },
+        { kMTMachineTypeAArch64,    CPU_SUBTYPE_ARM64E      },
+        { kMTMachineTypeARM64_32,   CPU_SUBTYPE_ARM64_32_V8 },
+        { kMTMachineTypeI386,       CPU_SUBTYPE_I386_ALL    },
+        { kMTMachineTypeI386,       CPU_SUBTYPE_486         },
+        { kMTMachineTypeI386,       CPU_SUBTYPE_486SX       },
+        { kMTMachineTypeI386,       CPU_SUBTYPE_PENT        },
+        { kMTMachineTypeI386,       CPU_SUBTYPE_PENTPRO     },
+        { kMTMachineTypeI386,       CPU_SUBTYPE_PENTII_M3   },
+        { kMTMachineTypeI386,       CPU_SUBTYPE_PENTII_M5   },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_ALL     },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_V4T     },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_V5TEJ   },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_XSCALE  },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_V6      },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_V6M     },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_V7      },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_V7F     },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_V7S     },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_V7K     },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_V7M     },
+        { kMTMachineTypeARM,        CPU_SUBTYPE_ARM_V7EM    },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_ALL },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_601 },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_603 },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_603e },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_603ev },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_604 },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_604e },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_750 },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_7400 },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_7450 },
+        { kMTMachineTypePowerPC,    CPU_SUBTYPE_POWERPC_970 },
+        { kMTMachineTypePowerPC64,  CPU_SUBTYPE_POWERPC_ALL },
+        { kMTMachineTypePowerPC64,  CPU_SUBTYPE_POWERPC_970 }
+    };
+
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++)
+    {
+        if (![MTMachinePairToArchName(pairs[i].type, pairs[i].subtype) isEqualToString:name])
+            continue;
+
+        if (type)
+            (*type) = pairs[i].type;
+
+        if (subtype)
+            (*subtype) = pairs[i].subtype;
+
+        return true;
+    }
+
+    return false;
+}
+
 // I don't support some of the more obscure things found here in cctools...
 NSString *MTMachinePairSubtypeName(MTMachineType type, MTMachineSubtype _subtype)
 {
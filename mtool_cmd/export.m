@@ -0,0 +1,81 @@
+#import "mtool.h"
+
+// For handing out files to workers
+#import <stdatomic.h>
+
+@implementation MTCExportCommand
+
+- (int) invoke
+{
+    // args[0] is the subcommand name.
+    if ([[self args] count] < 3)
+    {
+        printf("usage: mtool export <output> <path...>\n");
+
+        return 1;
+    }
+
+    NSURL *outputURL = [NSURL fileURLWithPath:[[self args] objectAtIndex:1]];
+    NSArray<NSURL *> *files = MTCFilesForPaths([[self args] subarrayWithRange:NSMakeRange(2, [[self args] count] - 2)]);
+
+    MTExportWriter *writer = [[MTExportWriter alloc] initWithURL:outputURL];
+
+    if (!writer)
+    {
+        printf("Error: Could not create %s\n", [[outputURL path] UTF8String]);
+
+        return 1;
+    }
+
+    // One shard per worker. Workers pull files off a shared counter, so no worker sits idle behind a large file.
+    NSUInteger workerCount = [[NSProcessInfo processInfo] activeProcessorCount];
+    NSMutableArray<MTExportShard *> *shards = [[NSMutableArray alloc] initWithCapacity:workerCount];
+
+    for (NSUInteger i = 0; i < workerCount; i++)
+        [shards addObject:[writer newShard]];
+
+    // This filter requests everything.
+    MTLoadFilter *filter = [MTLoadFilter filterForAllLoadCommands];
+    NSDate *start = [NSDate date];
+
+    atomic_ulong nextFile = 0;
+    atomic_ulong imageCount = 0;
+    atomic_bool failed = false;
+
+    atomic_ulong *next = &nextFile;
+    atomic_ulong *images = &imageCount;
+    atomic_bool *failure = &failed;
+
+    dispatch_apply(workerCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t worker) {
+        MTExportShard *shard = [shards objectAtIndex:worker];
+        NSUInteger index;
+
+        while (!atomic_load(failure) && (index = atomic_fetch_add(next, 1)) < [files count])
+        {
+            @autoreleasepool
+            {
+                NSURL *url = [files objectAtIndex:index];
+
+                NSUInteger count = MTCEnumerateImagesInFile(url, filter, ^(MTMachO *image, UInt64 offset, UInt64 size) {
+                    if (![shard addImage:image path:[url path] fileOffset:offset])
+                        atomic_store(failure, true);
+                });
+
+                atomic_fetch_add(images, count);
+            }
+        }
+    });
+
+    if (atomic_load(&failed) || ![writer finish])
+    {
+        printf("Error: Failed to write %s\n", [[outputURL path] UTF8String]);
+
+        return 1;
+    }
+
+    printf("exported %lu images from %lu files to %s in %.2fs\n", (unsigned long)atomic_load(&imageCount), (unsigned long)[files count], [[outputURL path] UTF8String], -[start timeIntervalSinceNow]);
+
+    return 0;
+}
+
+@end
@@ -0,0 +1,47 @@
+#import "mtool.h"
+
+@implementation MTCExtractCacheCommand
+
+- (int) invoke
+{
+    // args[0] is the subcommand name.
+    if ([[self args] count] < 3)
+    {
+        printf("usage: mtool extract-cache <cache> <output directory> [install name...]\n");
+
+        return 1;
+    }
+
+    NSURL *cacheURL = [NSURL fileURLWithPath:[[self args] objectAtIndex:1]];
+    NSURL *outputURL = [NSURL fileURLWithPath:[[self args] objectAtIndex:2] isDirectory:YES];
+
+    MTSharedCache *cache = [MTSharedCache loadFromURL:cacheURL];
+
+    if (!cache)
+    {
+        printf("Error: %s is not a valid shared cache\n", [[cacheURL path] UTF8String]);
+
+        return 1;
+    }
+
+    NSArray<MTSharedCacheImage *> *images = [cache images];
+
+    // Optionally, only extract the requested images.
+    if ([[self args] count] > 3)
+    {
+        NSSet<NSString *> *requested = [NSSet setWithArray:[[self args] subarrayWithRange:NSMakeRange(3, [[self args] count] - 3)]];
+
+        images = [images filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(MTSharedCacheImage *image, NSDictionary *bindings) {
+            return [requested containsObject:[image path]];
+        }]];
+    }
+
+    NSDate *start = [NSDate date];
+    NSUInteger extracted = [cache extractImages:images toDirectory:outputURL];
+
+    printf("extracted %lu of %lu images from %s (%s) in %.2fs\n", (unsigned long)extracted, (unsigned long)[images count], [[cacheURL path] UTF8String], [[cache architecture] UTF8String], -[start timeIntervalSinceNow]);
+
+    return (extracted == [images count]) ? 0 : 1;
+}
+
+@end
@@ -0,0 +1,206 @@
+#import "mtool.h"
+
+// For handing out files to workers
+#import <stdatomic.h>
+
+// Number of images listed in the ranking unless -top is given
+#define kMTCFootprintDefaultTop 20
+
+// One measured image
+@interface MTCFootprintEntry : NSObject
+
+@property (nonatomic, strong) NSString *path;
+@property (nonatomic, strong) NSString *arch;
+@property (nonatomic, strong) MTImageFootprint *footprint;
+
+@end
+
+@implementation MTCFootprintEntry
+
+@end
+
+// Not every machine pair has a name. Print the numbers for those.
+static NSString *MTCFootprintArchName(MTMachO *image)
+{
+    NSString *name = MTMachinePairToArchName([image machineType], [image subtype]);
+
+    if (name)
+        return name;
+
+    return [NSString stringWithFormat:@"cputype %d subtype %d", [image machineType], [image subtype] & ~kMTMachineCapabilitiesMask];
+}
+
+@implementation MTCFootprintCommand
+
+- (int) invoke
+{
+    NSArray<NSString *> *args = [self args];
+    NSMutableArray<NSString *> *paths = [[NSMutableArray alloc] init];
+    NSUInteger top = kMTCFootprintDefaultTop;
+
+    // Only segments and fixup commands are decoded.
+    MTLoadFilter *filter = [MTImageFootprint loadFilter];
+
+    // args[0] is the subcommand name.
+    for (NSUInteger i = 1; i < [args count]; i++)
+    {
+        NSString *arg = [args objectAtIndex:i];
+
+        if ([arg isEqualToString:@"-top"] && i + 1 < [args count]) {
+            top = (NSUInteger)[[args objectAtIndex:++i] integerValue];
+        } else if ([arg isEqualToString:@"-arch"] && i + 1 < [args count]) {
+            NSString *name = [args objectAtIndex:++i];
+            MTMachineSubtype subtype;
+            MTMachineType type;
+
+            if (!MTMachinePairFromArchName(name, &type, &subtype))
+            {
+                printf("Error: Unknown architecture '%s'\n", [name UTF8String]);
+
+                return 1;
+            }
+
+            [filter setMachineType:type];
+            [filter setSubtype:subtype];
+        } else if (![arg hasPrefix:@"-"]) {
+            [paths addObject:arg];
+        } else {
+            [paths removeAllObjects];
+
+            break;
+        }
+    }
+
+    if (![paths count])
+    {
+        printf("usage: mtool footprint [-top <count>] [-arch <arch>] <path...>\n");
+
+        return 1;
+    }
+
+    NSArray<NSURL *> *files = MTCFilesForPaths(paths);
+    NSUInteger workerCount = [[NSProcessInfo processInfo] activeProcessorCount];
+
+    // Each worker keeps its own results, so nothing is shared but the file counter.
+    NSMutableArray<NSMutableArray<MTCFootprintEntry *> *> *workerResults = [[NSMutableArray alloc] initWithCapacity:workerCount];
+
+    for (NSUInteger i = 0; i < workerCount; i++)
+        [workerResults addObject:[[NSMutableArray alloc] init]];
+
+    NSDate *start = [NSDate date];
+
+    atomic_ulong nextFile = 0;
+    atomic_ulong *next = &nextFile;
+
+    dispatch_apply(workerCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t worker) {
+        NSMutableArray<MTCFootprintEntry *> *results = [workerResults objectAtIndex:worker];
+        NSUInteger index;
+
+        while ((index = atomic_fetch_add(next, 1)) < [files count])
+        {
+            @autoreleasepool
+            {
+                NSURL *url = [files objectAtIndex:index];
+
+                MTCEnumerateImagesInFile(url, filter, ^(MTMachO *image, UInt64 offset, UInt64 size) {
+                    MTImageFootprint *footprint = [MTImageFootprint footprintForImage:image];
+
+                    if (!footprint)
+                    {
+                        printf("Warning: Couldn't measure %s (%s)\n", [[url path] UTF8String], [MTCFootprintArchName(image) UTF8String]);
+
+                        return;
+                    }
+
+                    MTCFootprintEntry *entry = [[MTCFootprintEntry alloc] init];
+                    [entry setPath:[url path]];
+                    [entry setArch:MTCFootprintArchName(image)];
+                    [entry setFootprint:footprint];
+
+                    [results addObject:entry];
+                });
+            }
+        }
+    });
+
+    NSMutableArray<MTCFootprintEntry *> *entries = [[NSMutableArray alloc] init];
+
+    for (NSArray<MTCFootprintEntry *> *results in workerResults)
+        [entries addObjectsFromArray:results];
+
+    // Worst first. Ties go to whichever could get worse (more zero fill), then by path so output is stable.
+    [entries sortUsingComparator:^NSComparisonResult(MTCFootprintEntry *a, MTCFootprintEntry *b) {
+        UInt64 aDirty = [[a footprint] dirtyBytes];
+        UInt64 bDirty = [[b footprint] dirtyBytes];
+
+        if (aDirty != bDirty)
+            return (aDirty > bDirty) ? NSOrderedAscending : NSOrderedDescending;
+
+        UInt64 aZeroFill = [[a footprint] zeroFillBytes];
+        UInt64 bZeroFill = [[b footprint] zeroFillBytes];
+
+        if (aZeroFill != bZeroFill)
+            return (aZeroFill > bZeroFill) ? NSOrderedAscending : NSOrderedDescending;
+
+        return [[a path] compare:[b path]];
+    }];
+
+    printf("measured %lu images from %lu files in %.2fs\n", (unsigned long)[entries count], (unsigned long)[files count], -[start timeIntervalSinceNow]);
+
+    // A universal binary only ever loads one slice, and page sizes differ between architectures,
+    //   so totals are only meaningful per architecture.
+    NSArray<NSString *> *arches = [[[NSSet setWithArray:[entries valueForKey:@"arch"]] allObjects] sortedArrayUsingSelector:@selector(compare:)];
+
+    for (NSString *arch in arches)
+    {
+        NSUInteger imageCount = 0;
+        UInt64 totalDirty = 0;
+        UInt64 totalZeroFill = 0;
+        UInt64 kindTotals[kMTSegmentKindLinkedit + 1] = {0};
+
+        for (MTCFootprintEntry *entry in entries)
+        {
+            if (![[entry arch] isEqualToString:arch])
+                continue;
+
+            MTImageFootprint *footprint = [entry footprint];
+
+            imageCount++;
+            totalDirty += [footprint dirtyBytes];
+            totalZeroFill += [footprint zeroFillBytes];
+
+            for (MTSegmentKind kind = kMTSegmentKindReadOnly; kind <= kMTSegmentKindLinkedit; kind++)
+                kindTotals[kind] += (UInt64)[footprint dirtyPageCountForKind:kind] * [footprint pageSize];
+        }
+
+        printf("\n%s (%lu images): dirty at load: %llu KB, zero fill: %llu KB\n", [arch UTF8String], (unsigned long)imageCount, totalDirty / 1024, totalZeroFill / 1024);
+
+        for (MTSegmentKind kind = kMTSegmentKindReadOnly; kind <= kMTSegmentKindLinkedit; kind++)
+        {
+            if (kindTotals[kind])
+                printf("    %-12s %llu KB\n", [MTSegmentKindName(kind) UTF8String], kindTotals[kind] / 1024);
+        }
+    }
+
+    printf("\nworst offenders:\n");
+
+    for (NSUInteger i = 0; i < MIN(top, [entries count]); i++)
+    {
+        MTCFootprintEntry *entry = [entries objectAtIndex:i];
+        MTImageFootprint *footprint = [entry footprint];
+
+        printf("%3lu. %8llu KB dirty %8llu KB zero fill  %s (%s)\n", (unsigned long)(i + 1), [footprint dirtyBytes] / 1024, [footprint zeroFillBytes] / 1024, [[entry path] UTF8String], [[entry arch] UTF8String]);
+
+        for (MTSegmentFootprint *segment in [footprint segments])
+        {
+            if (![segment dirtyPageCount] && ![segment zeroFillPageCount])
+                continue;
+
+            printf("        %-16s %-12s %lu of %lu pages dirty, %lu zero fill\n", [[segment name] UTF8String], [MTSegmentKindName([segment kind]) UTF8String], (unsigned long)[segment dirtyPageCount], (unsigned long)[segment pageCount], (unsigned long)[segment zeroFillPageCount]);
+        }
+    }
+
+    return 0;
+}
+
+@end
@@ -22,12 +22,28 @@
 
 @interface MToolCommand : NXCommand
 
+// Subcommands, keyed by the name used to invoke them on the command line.
++ (NSDictionary<NSString *, Class> *) subcommands;
+
 - (MTMachO *) findBinaryInProcess:(pid_t)pid withNameSuffix:(NSString *)suffix;
 
 @end
 
 @implementation MToolCommand
 
++ (NSDictionary<NSString *, Class> *) subcommands
+{
+    return @{
+        @"cache-symbols"    : [MTCCacheSymbolsCommand class],
+        @"extract-cache"    : [MTCExtractCacheCommand class],
+        @"export"           : [MTCExportCommand class],
+        @"footprint"        : [MTCFootprintCommand class],
+        @"query"            : [MTCQueryCommand class],
+        @"stream"           : [MTCStreamCommand class],
+        @"thin"             : [MTCThinCommand class]
+    };
+}
+
 - (MTMachO *) findBinaryInProcess:(pid_t)pid withNameSuffix:(NSString *)suffix
 {
     NSArray<NSDictionary<NSString *, id> *> *images = [MTMachO imageListFromProcess:pid];
@@ -46,6 +62,20 @@
 
 - (int) invoke
 {
+    // Subcommands get our arguments starting from their name. Anything else falls through to the tests below.
+    if ([[self args] count] > 1)
+    {
+        Class subcommand = [[MToolCommand subcommands] objectForKey:[[self args] objectAtIndex:1]];
+
+        if (subcommand)
+        {
+            NXCommand *command = [subcommand commandWithArguments:[[self args] subarrayWithRange:NSMakeRange(1, [[self args] count] - 1)]];
+            [command setAppleStrings:[self appleStrings]];
+
+            return [command invoke];
+        }
+    }
+
     NSLog(@"MTool invoked with state:");
     NSLog(@"Arguments: %@", [self args]);
     NSLog(@"Environment: %@", [self environment]);
@@ -3,6 +3,13 @@
 #import <LibObjC/LibObjC.h>
 #import <MTool/MTool.h>
 
+// Expand any directories in `paths` into the regular files inside them (recursively).
+extern NSArray<NSURL *> *MTCFilesForPaths(NSArray<NSString *> *paths);
+
+// Call `handler` for every Mach-O image accepted by `filter` in a file, thin or FAT. Other files are skipped quietly.
+// `offset` and `size` locate the image in the file. Returns the number of images found.
+extern NSUInteger MTCEnumerateImagesInFile(NSURL *url, MTLoadFilter *filter, void (^handler)(MTMachO *image, UInt64 offset, UInt64 size));
+
 // This class implements the interface for the lipo command shipped with macOS.
 @interface MTCLipoCommand : NXCommand
 
@@ -15,3 +22,46 @@
 - (void) detailedInfo;
 
 @end
+
+// This class implements `mtool extract-cache <cache> <output directory> [install name...]`
+// With no install names, every image in the cache is extracted.
+@interface MTCExtractCacheCommand : NXCommand
+
+@end
+
+// This class implements `mtool cache-symbols <cache> [symbol...]`
+// The symbol index is saved next to the cache (see MTSharedCacheSymbolIndex.h) and reused on later runs.
+@interface MTCCacheSymbolsCommand : NXCommand
+
+@end
+
+// This class implements `mtool footprint [-top <count>] <path...>`
+// Every image is measured for the pages its fixups dirty at load, then ranked from worst to best.
+@interface MTCFootprintCommand : NXCommand
+
+@end
+
+// This class implements `mtool query [predicates...] <path...>`
+// Each predicate tells the loaders which load commands and sections it needs, so only those are decoded.
+@interface MTCQueryCommand : NXCommand
+
+@end
+
+// This class implements `mtool export <output> <path...>`
+// Slices, load commands, dylib references and symbols are written to a columnar file (see MTExportWriter.h)
+@interface MTCExportCommand : NXCommand
+
+@end
+
+// This class implements `mtool stream [-o <output directory>] [<file> | -]`
+// The input is read once, front to back, so it can be a pipe. Slices are optionally split into the output directory.
+@interface MTCStreamCommand : NXCommand
+
+@end
+
+// This class implements `mtool thin [-n] [-arch <arch>...] <path...>`
+// Every FAT file under the paths is replaced in place with just the listed slices (by default, the current machine's).
+// With -n, nothing is changed, but the savings are still reported.
+@interface MTCThinCommand : NXCommand
+
+@end
@@ -0,0 +1,339 @@
+#import "mtool.h"
+
+#import <mach-o/loader.h>
+
+// For counting matches across workers
+#import <stdatomic.h>
+
+#pragma mark - Predicates
+
+// Every predicate says up front what it needs from an image, so the loaders can skip everything else.
+@protocol MTCQueryPredicate <NSObject>
+
+- (void) addRequirementsToFilter:(MTLoadFilter *)filter;
+
+- (BOOL) matchesImage:(MTMachO *)image;
+
+@end
+
+// --type <filetype>, ex. `dylib` or `execute`. This only needs the header.
+@interface MTCTypePredicate : NSObject <MTCQueryPredicate>
+
+@property (nonatomic, strong) NSString *typeName;
+
+@end
+
+@implementation MTCTypePredicate
+
+@synthesize typeName = _typeName;
+
+- (void) addRequirementsToFilter:(MTLoadFilter *)filter
+{
+    //
+}
+
+- (BOOL) matchesImage:(MTMachO *)image
+{
+    return [MTMachOImageTypeName([image type]) isEqualToString:[self typeName]];
+}
+
+@end
+
+// --links <install name>. Matches on any part of the install name, so `libfoo` matches `@rpath/libfoo.dylib`
+@interface MTCLinksPredicate : NSObject <MTCQueryPredicate>
+
+@property (nonatomic, strong) NSString *name;
+
+@end
+
+@implementation MTCLinksPredicate
+
+@synthesize name = _name;
+
+- (void) addRequirementsToFilter:(MTLoadFilter *)filter
+{
+    [filter addLoadCommand:LC_LOAD_DYLIB];
+    [filter addLoadCommand:LC_LOAD_WEAK_DYLIB];
+    [filter addLoadCommand:LC_REEXPORT_DYLIB];
+    [filter addLoadCommand:LC_LOAD_UPWARD_DYLIB];
+}
+
+- (BOOL) matchesImage:(MTMachO *)image
+{
+    for (MTLoadCommand *command in [image allLoadCommands])
+    {
+        if ([command isKindOfClass:[MTDylibInfo class]] && [[(MTDylibInfo *)command name] containsString:[self name]])
+            return YES;
+    }
+
+    return NO;
+}
+
+@end
+
+// --sdk-below <version>. Images without any version command never match.
+@interface MTCSDKBelowPredicate : NSObject <MTCQueryPredicate>
+
+// Encoded as in the load commands (xxxx.yy.zz)
+@property (nonatomic) UInt32 version;
+
+@end
+
+@implementation MTCSDKBelowPredicate
+
+@synthesize version = _version;
+
+- (void) addRequirementsToFilter:(MTLoadFilter *)filter
+{
+    [filter addLoadCommand:LC_BUILD_VERSION];
+    [filter addLoadCommand:LC_VERSION_MIN_MACOSX];
+    [filter addLoadCommand:LC_VERSION_MIN_IPHONEOS];
+    [filter addLoadCommand:LC_VERSION_MIN_TVOS];
+    [filter addLoadCommand:LC_VERSION_MIN_WATCHOS];
+}
+
+- (BOOL) matchesImage:(MTMachO *)image
+{
+    for (MTLoadCommand *command in [image allLoadCommands])
+    {
+        if ([command isKindOfClass:[MTBuildVersionInfo class]] && [(MTBuildVersionInfo *)command sdkVersion] < [self version])
+            return YES;
+    }
+
+    return NO;
+}
+
+@end
+
+// --section <segment>,<section>
+@interface MTCSectionPredicate : NSObject <MTCQueryPredicate>
+
+@property (nonatomic, strong) NSString *segment;
+
+@property (nonatomic, strong) NSString *section;
+
+@end
+
+@implementation MTCSectionPredicate
+
+@synthesize segment = _segment;
+@synthesize section = _section;
+
+- (void) addRequirementsToFilter:(MTLoadFilter *)filter
+{
+    [filter addSectionNamed:[self section] inSegment:[self segment]];
+}
+
+- (BOOL) matchesImage:(MTMachO *)image
+{
+    for (MTSegmentInfo *segment in [image segments])
+    {
+        if (![[segment name] isEqualToString:[self segment]])
+            continue;
+
+        for (MTSectionInfo *section in [segment sections])
+        {
+            if ([[section name] isEqualToString:[self section]])
+                return YES;
+        }
+    }
+
+    return NO;
+}
+
+@end
+
+#pragma mark - Support routines
+
+// Parse `xxxx[.yy[.zz]]` into the load command version encoding. Returns 0 if malformed.
+static UInt32 MTCParseVersion(NSString *string)
+{
+    NSArray<NSString *> *components = [string componentsSeparatedByString:@"."];
+    UInt32 shifts[3] = { 16, 8, 0 };
+    UInt32 version = 0;
+
+    if (![components count] || [components count] > 3)
+        return 0;
+
+    for (NSUInteger i = 0; i < [components count]; i++)
+    {
+        NSInteger value = [[components objectAtIndex:i] integerValue];
+
+        if (value < 0 || value > (i ? 0xFF : 0xFFFF))
+            return 0;
+
+        version |= ((UInt32)value << shifts[i]);
+    }
+
+    return version;
+}
+
+#pragma mark - MTCQueryCommand
+
+@implementation MTCQueryCommand
+
+- (void) usage
+{
+    printf("usage: mtool query [--arch <arch>] [--type <filetype>] [--links <install name>] [--sdk-below <version>] [--section <segment>,<section>] <path...>\n");
+    printf("Prints every image slice in <path...> matching all of the given predicates. Directories are searched recursively.\n");
+}
+
+- (BOOL) image:(MTMachO *)image matchesPredicates:(NSArray<id<MTCQueryPredicate>> *)predicates
+{
+    for (id<MTCQueryPredicate> predicate in predicates)
+    {
+        if (![predicate matchesImage:image])
+            return NO;
+    }
+
+    return YES;
+}
+
+// Returns the architectures of every matching slice in the file.
+- (NSArray<NSString *> *) matchesInFile:(NSURL *)url filter:(MTLoadFilter *)filter predicates:(NSArray<id<MTCQueryPredicate>> *)predicates
+{
+    NSMutableArray<NSString *> *matches = [[NSMutableArray alloc] init];
+
+    MTCEnumerateImagesInFile(url, filter, ^(MTMachO *image, UInt64 offset, UInt64 size) {
+        if ([self image:image matchesPredicates:predicates])
+            [matches addObject:MTMachinePairToArchName([image machineType], [image subtype])];
+    });
+
+    return matches;
+}
+
+- (int) invoke
+{
+    NSArray<NSString *> *args = [self args];
+    NSMutableArray<id<MTCQueryPredicate>> *predicates = [[NSMutableArray alloc] init];
+    NSMutableArray<NSString *> *paths = [[NSMutableArray alloc] init];
+    MTLoadFilter *filter = [[MTLoadFilter alloc] init];
+
+    // args[0] is the subcommand name.
+    for (NSUInteger i = 1; i < [args count]; i++)
+    {
+        NSString *arg = [args objectAtIndex:i];
+
+        if (![arg hasPrefix:@"--"])
+        {
+            [paths addObject:arg];
+
+            continue;
+        }
+
+        if (i + 1 >= [args count])
+        {
+            printf("Error: %s requires a value\n", [arg UTF8String]);
+
+            return 1;
+        }
+
+        NSString *value = [args objectAtIndex:++i];
+
+        if ([arg isEqualToString:@"--arch"]) {
+            MTMachineSubtype subtype;
+            MTMachineType type;
+
+            if (!MTMachinePairFromArchName(value, &type, &subtype))
+            {
+                printf("Error: Unknown architecture '%s'\n", [value UTF8String]);
+
+                return 1;
+            }
+
+            [filter setMachineType:type];
+            [filter setSubtype:subtype];
+        } else if ([arg isEqualToString:@"--type"]) {
+            MTCTypePredicate *predicate = [[MTCTypePredicate alloc] init];
+            [predicate setTypeName:[@"MH_" stringByAppendingString:[value uppercaseString]]];
+            [predicates addObject:predicate];
+        } else if ([arg isEqualToString:@"--links"]) {
+            MTCLinksPredicate *predicate = [[MTCLinksPredicate alloc] init];
+            [predicate setName:value];
+            [predicates addObject:predicate];
+        } else if ([arg isEqualToString:@"--sdk-below"]) {
+            MTCSDKBelowPredicate *predicate = [[MTCSDKBelowPredicate alloc] init];
+            [predicate setVersion:MTCParseVersion(value)];
+
+            if (![predicate version])
+            {
+                printf("Error: Malformed version '%s'\n", [value UTF8String]);
+
+                return 1;
+            }
+
+            [predicates addObject:predicate];
+        } else if ([arg isEqualToString:@"--section"]) {
+            NSArray<NSString *> *names = [value componentsSeparatedByString:@","];
+
+            if ([names count] != 2)
+            {
+                printf("Error: Sections are specified as <segment>,<section>\n");
+
+                return 1;
+            }
+
+            MTCSectionPredicate *predicate = [[MTCSectionPredicate alloc] init];
+            [predicate setSegment:[names objectAtIndex:0]];
+            [predicate setSection:[names objectAtIndex:1]];
+            [predicates addObject:predicate];
+        } else {
+            printf("Error: Unknown option '%s'\n", [arg UTF8String]);
+            [self usage];
+
+            return 1;
+        }
+    }
+
+    if (![paths count])
+    {
+        [self usage];
+
+        return 1;
+    }
+
+    // The loaders decode exactly the union of what the predicates need, and nothing more.
+    for (id<MTCQueryPredicate> predicate in predicates)
+        [predicate addRequirementsToFilter:filter];
+
+    NSArray<NSURL *> *files = MTCFilesForPaths(paths);
+    NSMutableArray<NSArray<NSString *> *> *results = [[NSMutableArray alloc] initWithCapacity:[files count]];
+
+    for (NSUInteger i = 0; i < [files count]; i++)
+        [results addObject:@[]];
+
+    NSDate *start = [NSDate date];
+    atomic_ulong matchCount = 0;
+    atomic_ulong *matched = &matchCount;
+
+    // Files are independent. The filter is only read from here on, so it is shared between all workers.
+    dispatch_apply([files count], dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t i) {
+        @autoreleasepool
+        {
+            NSArray<NSString *> *matches = [self matchesInFile:[files objectAtIndex:i] filter:filter predicates:predicates];
+
+            if (![matches count])
+                return;
+
+            atomic_fetch_add(matched, [matches count]);
+
+            @synchronized (results)
+            {
+                [results replaceObjectAtIndex:i withObject:matches];
+            }
+        }
+    });
+
+    // Print in input order, so output is stable between runs.
+    for (NSUInteger i = 0; i < [files count]; i++)
+    {
+        for (NSString *arch in [results objectAtIndex:i])
+            printf("%s (%s)\n", [[[files objectAtIndex:i] path] UTF8String], [arch UTF8String]);
+    }
+
+    fprintf(stderr, "%lu matching slices in %lu files scanned in %.2fs\n", (unsigned long)atomic_load(&matchCount), (unsigned long)[files count], -[start timeIntervalSinceNow]);
+
+    return 0;
+}
+
+@end
@@ -0,0 +1,99 @@
+#import "mtool.h"
+
+#import <mach-o/loader.h>
+#import <mach-o/fat.h>
+
+static BOOL MTCIsMachO(const void *bytes, NSUInteger length)
+{
+    if (length < sizeof(UInt32))
+        return NO;
+
+    UInt32 magic = *(const UInt32 *)bytes;
+
+    return (magic == MH_MAGIC || magic == MH_CIGAM || magic == MH_MAGIC_64 || magic == MH_CIGAM_64);
+}
+
+static BOOL MTCIsFat(const void *bytes, NSUInteger length)
+{
+    if (length < sizeof(struct fat_header))
+        return NO;
+
+    UInt32 magic = MTSwapToHostEndian(*(const UInt32 *)bytes);
+
+    return (magic == FAT_MAGIC || magic == FAT_MAGIC_64);
+}
+
+NSArray<NSURL *> *MTCFilesForPaths(NSArray<NSString *> *paths)
+{
+    NSMutableArray<NSURL *> *files = [[NSMutableArray alloc] init];
+    NSFileManager *manager = [NSFileManager defaultManager];
+
+    for (NSString *path in paths)
+    {
+        BOOL isDirectory = NO;
+
+        if (![manager fileExistsAtPath:path isDirectory:&isDirectory])
+        {
+            printf("Warning: %s does not exist\n", [path UTF8String]);
+
+            continue;
+        }
+
+        if (!isDirectory)
+        {
+            [files addObject:[NSURL fileURLWithPath:path]];
+
+            continue;
+        }
+
+        NSDirectoryEnumerator<NSURL *> *enumerator = [manager enumeratorAtURL:[NSURL fileURLWithPath:path isDirectory:YES] includingPropertiesForKeys:@[NSURLIsRegularFileKey] options:0 errorHandler:nil];
+
+        for (NSURL *url in enumerator)
+        {
+            NSNumber *isRegularFile;
+
+            if ([url getResourceValue:&isRegularFile forKey:NSURLIsRegularFileKey error:nil] && [isRegularFile boolValue])
+                [files addObject:url];
+        }
+    }
+
+    return files;
+}
+
+NSUInteger MTCEnumerateImagesInFile(NSURL *url, MTLoadFilter *filter, void (^handler)(MTMachO *image, UInt64 offset, UInt64 size))
+{
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:nil];
+    const UInt8 *bytes = (const UInt8 *)[data bytes];
+    NSUInteger count = 0;
+
+    // Most files in a corpus aren't even Mach-O. Only the first page of the mapping is touched to find that out.
+    if (MTCIsMachO(bytes, [data length])) {
+        MTMachO *image = [MTMachO loadFromData:data filter:filter];
+
+        if (image)
+        {
+            handler(image, 0, [data length]);
+            count++;
+        }
+    } else if (MTCIsFat(bytes, [data length])) {
+        // This rejects the file from the FAT header alone if no slice has the right architecture.
+        MTFatFile *fatFile = [MTFatFile loadFromData:data filter:filter];
+
+        for (MTFatFileEntryDescriptor *entry in [fatFile membersMatchingFilter:filter])
+        {
+            // Slices can be archives or anything else. Don't try to parse those.
+            if ([entry offset] >= [data length] || !MTCIsMachO(bytes + [entry offset], (NSUInteger)([data length] - [entry offset])))
+                continue;
+
+            MTMachO *image = [fatFile imageForEntry:entry filter:filter];
+
+            if (image)
+            {
+                handler(image, [entry offset], [entry size]);
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,75 @@
+#import "mtool.h"
+
+@implementation MTCStreamCommand
+
+- (int) invoke
+{
+    NSArray<NSString *> *args = [self args];
+    NSString *outputDirectory = nil;
+    NSString *input = @"-";
+
+    // args[0] is the subcommand name.
+    for (NSUInteger i = 1; i < [args count]; i++)
+    {
+        NSString *arg = [args objectAtIndex:i];
+
+        if ([arg isEqualToString:@"-o"] && i + 1 < [args count]) {
+            outputDirectory = [args objectAtIndex:++i];
+        } else if (![arg hasPrefix:@"-"] || [arg isEqualToString:@"-"]) {
+            input = arg;
+        } else {
+            printf("usage: mtool stream [-o <output directory>] [<file> | -]\n");
+
+            return 1;
+        }
+    }
+
+    if (outputDirectory && ![[NSFileManager defaultManager] createDirectoryAtPath:outputDirectory withIntermediateDirectories:YES attributes:nil error:nil])
+    {
+        printf("Error: Could not create %s\n", [outputDirectory UTF8String]);
+
+        return 1;
+    }
+
+    MTStreamReader *reader;
+
+    if ([input isEqualToString:@"-"]) {
+        reader = [MTStreamReader readerForStandardInput];
+    } else {
+        reader = [[MTStreamReader alloc] initWithInputStream:[NSInputStream inputStreamWithFileAtPath:input]];
+    }
+
+    [reader setSliceHandler:^(MTStreamSlice *slice) {
+        NSString *arch = MTMachinePairToArchName([slice type], [slice subtype]);
+        MTMachO *image = [slice image];
+
+        if (image) {
+            printf("slice %lu: %s %s, %lu load commands, offset %llu\n", (unsigned long)[slice index], [arch UTF8String], [MTMachOImageTypeName([image type]) UTF8String], (unsigned long)[[image allLoadCommands] count], [slice offset]);
+        } else {
+            printf("slice %lu: %s (not a Mach-O image), offset %llu\n", (unsigned long)[slice index], [arch UTF8String], [slice offset]);
+        }
+    }];
+
+    if (outputDirectory)
+    {
+        [reader setOutputForSlice:^NSOutputStream *(MTStreamSlice *slice) {
+            // The type isn't known for thin images until the header has passed, so name slices by index.
+            NSString *path = [outputDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"slice%lu", (unsigned long)[slice index]]];
+
+            return [NSOutputStream outputStreamToFileAtPath:path append:NO];
+        }];
+    }
+
+    if (![reader read])
+    {
+        printf("Error: Failed to read %s\n", [input UTF8String]);
+
+        return 1;
+    }
+
+    printf("%s: %s with %lu slices\n", [input UTF8String], [reader isFat] ? "fat file" : "thin file", (unsigned long)[[reader slices] count]);
+
+    return 0;
+}
+
+@end
@@ -0,0 +1,62 @@
+#import "mtool.h"
+
+@implementation MTCCacheSymbolsCommand
+
+- (int) invoke
+{
+    // args[0] is the subcommand name.
+    if ([[self args] count] < 2)
+    {
+        printf("usage: mtool cache-symbols <cache> [symbol...]\n");
+
+        return 1;
+    }
+
+    NSURL *cacheURL = [NSURL fileURLWithPath:[[self args] objectAtIndex:1]];
+    MTSharedCache *cache = [MTSharedCache loadFromURL:cacheURL];
+
+    if (!cache)
+    {
+        printf("Error: %s is not a valid shared cache\n", [[cacheURL path] UTF8String]);
+
+        return 1;
+    }
+
+    NSDate *start = [NSDate date];
+    MTSharedCacheSymbolIndex *index = [MTSharedCacheSymbolIndex indexForCache:cache];
+
+    if (!index)
+    {
+        printf("Error: Failed to build symbol index for %s\n", [[cacheURL path] UTF8String]);
+
+        return 1;
+    }
+
+    // With no symbols, this just makes sure the index exists.
+    if ([[self args] count] == 2)
+    {
+        printf("%lu symbols indexed for %s in %.2fs\n", (unsigned long)[index symbolCount], [[cacheURL path] UTF8String], -[start timeIntervalSinceNow]);
+
+        return 0;
+    }
+
+    int result = 0;
+
+    for (NSString *symbol in [[self args] subarrayWithRange:NSMakeRange(2, [[self args] count] - 2)])
+    {
+        UInt64 address;
+        MTSharedCacheImage *image = [index imageExportingSymbol:symbol address:&address];
+
+        if (!image) {
+            printf("%s: not found\n", [symbol UTF8String]);
+
+            result = 1;
+        } else {
+            printf("%s: 0x%016llx %s\n", [symbol UTF8String], address, [[image path] UTF8String]);
+        }
+    }
+
+    return result;
+}
+
+@end
@@ -0,0 +1,87 @@
+#import "mtool.h"
+
+// For counting results across workers
+#import <stdatomic.h>
+
+@implementation MTCThinCommand
+
+- (int) invoke
+{
+    NSArray<NSString *> *args = [self args];
+    NSMutableArray<NSString *> *archNames = [[NSMutableArray alloc] init];
+    NSMutableArray<NSString *> *paths = [[NSMutableArray alloc] init];
+    BOOL dryRun = NO;
+
+    // args[0] is the subcommand name.
+    for (NSUInteger i = 1; i < [args count]; i++)
+    {
+        NSString *arg = [args objectAtIndex:i];
+
+        if ([arg isEqualToString:@"-arch"] && i + 1 < [args count]) {
+            [archNames addObject:[args objectAtIndex:++i]];
+        } else if ([arg isEqualToString:@"-n"]) {
+            dryRun = YES;
+        } else if (![arg hasPrefix:@"-"]) {
+            [paths addObject:arg];
+        } else {
+            [paths removeAllObjects];
+
+            break;
+        }
+    }
+
+    if (![paths count])
+    {
+        printf("usage: mtool thin [-n] [-arch <arch>...] <path...>\n");
+
+        return 1;
+    }
+
+    // With no architectures, keep whatever this machine runs.
+    MTFatFileThinner *thinner = [archNames count] ? [MTFatFileThinner thinnerForArchNames:archNames] : [MTFatFileThinner thinnerForCurrentMachine];
+
+    if (!thinner)
+    {
+        printf("Error: Unknown architecture\n");
+
+        return 1;
+    }
+
+    [thinner setDryRun:dryRun];
+
+    NSArray<NSURL *> *files = MTCFilesForPaths(paths);
+    NSDate *start = [NSDate date];
+
+    atomic_ulong thinnedCount = 0;
+    atomic_ulong failedCount = 0;
+
+    atomic_ulong *thinned = &thinnedCount;
+    atomic_ulong *failed = &failedCount;
+
+    UInt64 saved = [thinner thinFilesAtURLs:files handler:^(NSURL *url, MTThinResult result, UInt64 bytesSaved) {
+        switch (result)
+        {
+            case kMTThinResultThinned: {
+                printf("%s: %s %llu bytes\n", [[url path] UTF8String], dryRun ? "would save" : "saved", bytesSaved);
+
+                atomic_fetch_add(thinned, 1);
+            } break;
+            case kMTThinResultNoMatch: {
+                printf("Warning: %s has no matching slices\n", [[url path] UTF8String]);
+            } break;
+            case kMTThinResultFailed: {
+                printf("Error: Failed to thin %s\n", [[url path] UTF8String]);
+
+                atomic_fetch_add(failed, 1);
+            } break;
+            default:
+                break;
+        }
+    }];
+
+    printf("%s %lu of %lu files in %.2fs, saving %llu bytes (%.1f MB)\n", dryRun ? "would thin" : "thinned", (unsigned long)atomic_load(&thinnedCount), (unsigned long)[files count], -[start timeIntervalSinceNow], saved, (double)saved / (1024.0 * 1024.0));
+
+    return atomic_load(&failedCount) ? 1 : 0;
+}
+
+@end